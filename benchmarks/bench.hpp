@@ -0,0 +1,106 @@
+/**
+    This file is part of jtypes.
+
+    Copyright(C) 2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of MIT license. See the LICENSE file for details.
+*/
+
+#ifndef JTYPES_BENCH_H
+#define JTYPES_BENCH_H
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+#include <string>
+
+// Minimal benchmarking support. Include from exactly one translation unit per
+// benchmark executable, as it replaces global operator new / delete in order
+// to count heap allocations and live heap bytes.
+
+namespace bench {
+    
+    inline std::size_t &allocations() {
+        static std::size_t n = 0;
+        return n;
+    }
+    
+    inline std::size_t &live_bytes() {
+        static std::size_t n = 0;
+        return n;
+    }
+    
+    // High water mark of live_bytes(), reset by assigning live_bytes().
+    inline std::size_t &peak_bytes() {
+        static std::size_t n = 0;
+        return n;
+    }
+    
+    struct result {
+        double ms;
+        std::size_t allocs;
+    };
+    
+    template<typename F>
+    inline result measure(F f, int repetitions = 1) {
+        std::size_t a0 = allocations();
+        auto t0 = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < repetitions; ++i) {
+            f();
+        }
+        auto t1 = std::chrono::high_resolution_clock::now();
+        
+        result r;
+        r.ms = std::chrono::duration<double, std::milli>(t1 - t0).count() / repetitions;
+        r.allocs = (allocations() - a0) / repetitions;
+        return r;
+    }
+    
+    inline void report(const std::string &name, const result &r) {
+        std::printf("%-48s %12.3f ms %14zu allocs\n", name.c_str(), r.ms, r.allocs);
+    }
+    
+    inline void report_memory(const std::string &name, std::size_t bytes) {
+        std::printf("%-48s %12.3f MB\n", name.c_str(), bytes / (1024.0 * 1024.0));
+    }
+    
+    template<typename T>
+    inline void do_not_optimize(const T &v) {
+        static volatile const void *sink;
+        sink = &v;
+    }
+}
+
+// Each block is prefixed by its size to track live bytes.
+static const std::size_t bench_header = alignof(std::max_align_t);
+
+void *operator new(std::size_t n) {
+    ++bench::allocations();
+    bench::live_bytes() += n;
+    if (bench::live_bytes() > bench::peak_bytes()) {
+        bench::peak_bytes() = bench::live_bytes();
+    }
+    if (char *p = static_cast<char*>(std::malloc(n + bench_header))) {
+        *reinterpret_cast<std::size_t*>(p) = n;
+        return p + bench_header;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    if (!p)
+        return;
+    char *b = static_cast<char*>(p) - bench_header;
+    bench::live_bytes() -= *reinterpret_cast<std::size_t*>(b);
+    std::free(b);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    operator delete(p);
+}
+
+#endif
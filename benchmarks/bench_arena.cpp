@@ -0,0 +1,62 @@
+/**
+    This file is part of jtypes.
+
+    Copyright(C) 2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of MIT license. See the LICENSE file for details.
+*/
+
+#include "bench.hpp"
+
+#include <jtypes/jtypes.hpp>
+#include <jtypes/jtypes_io.hpp>
+
+// Compare runs with and without JTYPES_ARENA_ALLOCATION.
+
+using jtypes::jtype;
+using jtypes::arena;
+
+int main() {
+    std::string json = "[";
+    for (int i = 0; i < 100000; ++i) {
+        if (i > 0) json += ",";
+        json += "{\"id\":" + std::to_string(i) + ",\"tags\":[1,2,3],\"enabled\":true,\"weight\":0.5}";
+    }
+    json += "]";
+    
+    bench::report("parse and destroy on the heap", bench::measure([&]() {
+        jtype doc = jtypes::from_json(json);
+        bench::do_not_optimize(doc);
+    }));
+    
+    bench::report("parse and destroy in an arena", bench::measure([&]() {
+        arena a(1 << 20);
+        arena::scope scope(a);
+        jtype doc = jtypes::from_json(json);
+        bench::do_not_optimize(doc);
+    }));
+    
+    auto build = [](int n) {
+        jtype doc = jtype::array();
+        for (int i = 0; i < n; ++i) {
+            doc.push_back(jtype::object({{"id", i}, {"tags", jtype::array({1, 2, 3})}, {"enabled", true}}));
+        }
+        return doc;
+    };
+    
+    bench::report("build and destroy on the heap", bench::measure([&]() {
+        jtype doc = build(100000);
+        bench::do_not_optimize(doc);
+    }));
+    
+    bench::report("build and destroy in an arena", bench::measure([&]() {
+        arena a(1 << 20);
+        arena::scope scope(a);
+        jtype doc = build(100000);
+        bench::do_not_optimize(doc);
+    }));
+    
+    return 0;
+}
@@ -0,0 +1,57 @@
+/**
+    This file is part of jtypes.
+
+    Copyright(C) 2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of MIT license. See the LICENSE file for details.
+*/
+
+#include "bench.hpp"
+
+#include <jtypes/jtypes.hpp>
+#include <jtypes/jtypes_io.hpp>
+#include <jtypes/jtypes_typed.hpp>
+
+// Operations over homogeneous numeric arrays.
+
+using jtypes::jtype;
+
+int main() {
+    const int n = 1000000;
+    
+    jtype ints = jtype::array();
+    jtype reals = jtype::array();
+    for (int i = 0; i < n; ++i) {
+        ints.push_back(i);
+        reals.push_back(i * 0.5);
+    }
+    
+    const jtype ints2 = ints;
+    const jtype reals2 = reals;
+    
+    bench::report("equality of int arrays", bench::measure([&]() {
+        bench::do_not_optimize(ints == ints2);
+    }, 10));
+    
+    bench::report("equality of double arrays", bench::measure([&]() {
+        bench::do_not_optimize(reals == reals2);
+    }, 10));
+    
+    bench::report("less-than of int arrays", bench::measure([&]() {
+        bench::do_not_optimize(ints < ints2);
+    }, 10));
+    
+    bench::report("coerce to float64_array", bench::measure([&]() {
+        jtypes::float64_array a(reals);
+        bench::do_not_optimize(a);
+    }, 10));
+    
+    bench::report("to_json of double array", bench::measure([&]() {
+        std::string s = jtypes::to_json(reals);
+        bench::do_not_optimize(s);
+    }));
+    
+    return 0;
+}
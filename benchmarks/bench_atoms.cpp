@@ -0,0 +1,70 @@
+/**
+    This file is part of jtypes.
+
+    Copyright(C) 2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of MIT license. See the LICENSE file for details.
+*/
+
+#include "bench.hpp"
+
+#include <jtypes/jtypes.hpp>
+
+// Compare runs with and without JTYPES_INTERN_KEYS.
+
+using jtypes::jtype;
+using jtypes::atom;
+
+int main() {
+    const int n = 200000;
+    
+    jtype records = jtype::array();
+    
+    bench::report("build records", bench::measure([&]() {
+        records = jtype::array();
+        for (int i = 0; i < n; ++i) {
+            jtype r = jtype::object();
+            r["identifier"] = i;
+            r["timestamp_in_milliseconds"] = i * 10;
+            r["measured_value"] = i * 0.5;
+            r["source_description"] = "sensor";
+            records.push_back(std::move(r));
+        }
+    }));
+    
+    bench::report_memory("records resident", bench::live_bytes());
+    
+    const jtype &crecords = records;
+    
+    bench::report("lookup with string key", bench::measure([&]() {
+        double sum = 0;
+        for (auto && r : crecords) {
+            sum += r["measured_value"].as<double>();
+        }
+        bench::do_not_optimize(sum);
+    }));
+    
+    const atom key("measured_value");
+    
+    bench::report("lookup with atom key", bench::measure([&]() {
+        double sum = 0;
+        for (auto && r : crecords) {
+            sum += r[key].as<double>();
+        }
+        bench::do_not_optimize(sum);
+    }));
+    
+    const jtype::property_accessor accessor("measured_value");
+    
+    bench::report("lookup with property accessor", bench::measure([&]() {
+        double sum = 0;
+        for (auto && r : crecords) {
+            sum += accessor(r).as<double>();
+        }
+        bench::do_not_optimize(sum);
+    }));
+    
+    return 0;
+}
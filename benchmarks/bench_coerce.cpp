@@ -0,0 +1,62 @@
+/**
+    This file is part of jtypes.
+
+    Copyright(C) 2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of MIT license. See the LICENSE file for details.
+*/
+
+#include "bench.hpp"
+
+#include <jtypes/jtypes.hpp>
+
+#include <random>
+
+// Coercion of numeric strings, as in ingestion code reading string fields.
+
+using jtypes::jtype;
+
+template<class T>
+void run(const std::string &name, const std::vector<jtype> &values) {
+    bench::report(name + " as<T>() with catch", bench::measure([&]() {
+        std::size_t failed = 0;
+        for (auto && v : values) {
+            try {
+                bench::do_not_optimize(v.as<T>());
+            } catch (jtypes::type_error &) {
+                ++failed;
+            }
+        }
+        bench::do_not_optimize(failed);
+    }));
+    
+    bench::report(name + " try_as<T>()", bench::measure([&]() {
+        std::size_t failed = 0;
+        for (auto && v : values) {
+            auto r = v.try_as<T>();
+            if (!r) ++failed;
+            bench::do_not_optimize(r);
+        }
+        bench::do_not_optimize(failed);
+    }));
+}
+
+int main() {
+    const int n = 1000000;
+    
+    std::mt19937_64 rng(42);
+    std::vector<jtype> ints, reals, malformed;
+    for (int i = 0; i < n; ++i) {
+        ints.push_back(std::to_string(std::int64_t(rng() % 100000000) - 50000000));
+        reals.push_back(std::to_string(std::uniform_real_distribution<double>(-1e6, 1e6)(rng)));
+        malformed.push_back(i % 2 ? std::string("n/a") : std::to_string(i) + "px");
+    }
+    
+    run<std::int64_t>("int64 from integer strings", ints);
+    run<double>("double from decimal strings", reals);
+    run<std::int64_t>("int64 from malformed strings", malformed);
+    
+    return 0;
+}
@@ -0,0 +1,54 @@
+/**
+    This file is part of jtypes.
+
+    Copyright(C) 2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of MIT license. See the LICENSE file for details.
+*/
+
+#include "bench.hpp"
+
+#include <jtypes/jtypes.hpp>
+#include <jtypes/jtypes_io.hpp>
+
+// Compare runs with and without JTYPES_COPY_ON_WRITE.
+
+using jtypes::jtype;
+
+int main() {
+    std::string json = "[";
+    for (int i = 0; i < 10000; ++i) {
+        if (i > 0) json += ",";
+        json += "{\"id\":" + std::to_string(i) + ",\"name\":\"node\",\"enabled\":true,\"weight\":0.5}";
+    }
+    json += "]";
+    
+    const jtype config = jtypes::from_json(json);
+    
+    bench::report("copy and read config", bench::measure([&]() {
+        jtype c = config;
+        const jtype &cc = c;
+        bench::do_not_optimize(cc[5000]["id"]);
+    }, 100));
+    
+    bench::report("copy and modify one property", bench::measure([&]() {
+        jtype c = config;
+        c[5000]["id"] = -1;
+        bench::do_not_optimize(c);
+    }, 100));
+    
+#if defined(JTYPES_COPY_ON_WRITE)
+    bench::report("keep 100 versions with one change each", bench::measure([&]() {
+        std::vector<jtype> history(1, config);
+        for (int i = 0; i < 100; ++i) {
+            const jtype &last = history.back();
+            history.push_back(last.with(i, last[i].with("enabled", false)));
+        }
+        bench::do_not_optimize(history);
+    }));
+#endif
+    
+    return 0;
+}
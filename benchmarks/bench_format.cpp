@@ -0,0 +1,85 @@
+/**
+    This file is part of jtypes.
+
+    Copyright(C) 2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of MIT license. See the LICENSE file for details.
+*/
+
+#include "bench.hpp"
+
+#include <jtypes/jtypes.hpp>
+#include <jtypes/jtypes_io.hpp>
+
+#include <cstdio>
+#include <random>
+
+// Number to string conversion of as<std::string>() and to_json() against the standard library.
+
+using jtypes::jtype;
+
+int main() {
+    const int n = 1000000;
+    
+    std::mt19937_64 rng(42);
+    std::vector<std::int64_t> ints;
+    std::vector<double> reals, shorts;
+    for (int i = 0; i < n; ++i) {
+        ints.push_back(std::int64_t(rng() >> (rng() % 64)) - (std::int64_t(1) << 20));
+        reals.push_back(std::uniform_real_distribution<double>(-1e6, 1e6)(rng));
+        shorts.push_back(double(std::int64_t(rng() % 100000)) / 100.0);
+    }
+    
+    char buf[64];
+    
+    bench::report("int64 std::to_string", bench::measure([&]() {
+        for (auto v : ints) bench::do_not_optimize(std::to_string(v));
+    }));
+    
+    bench::report("int64 snprintf", bench::measure([&]() {
+        for (auto v : ints) bench::do_not_optimize(std::snprintf(buf, sizeof(buf), "%lld", (long long)v));
+    }));
+    
+    bench::report("int64 format_number", bench::measure([&]() {
+        for (auto v : ints) bench::do_not_optimize(jtypes::details::format_number(v, buf));
+    }));
+    
+    bench::report("int64 as<std::string>()", bench::measure([&]() {
+        for (auto v : ints) bench::do_not_optimize(jtype(v).as<std::string>());
+    }));
+    
+    const std::pair<const char*, const std::vector<double>*> sets[] = {{"random double", &reals}, {"short double", &shorts}};
+    for (auto && set : sets) {
+        const std::string name = set.first;
+        const std::vector<double> &values = *set.second;
+        
+        bench::report(name + " std::to_string", bench::measure([&]() {
+            for (auto v : values) bench::do_not_optimize(std::to_string(v));
+        }));
+        
+        bench::report(name + " snprintf %.17g", bench::measure([&]() {
+            for (auto v : values) bench::do_not_optimize(std::snprintf(buf, sizeof(buf), "%.17g", v));
+        }));
+        
+        bench::report(name + " format_number", bench::measure([&]() {
+            for (auto v : values) bench::do_not_optimize(jtypes::details::format_number(v, buf));
+        }));
+        
+        bench::report(name + " as<std::string>()", bench::measure([&]() {
+            for (auto v : values) bench::do_not_optimize(jtype(v).as<std::string>());
+        }));
+    }
+    
+    jtype a = jtype::array();
+    for (auto v : reals) {
+        a.push_back(v);
+    }
+    
+    bench::report("to_json of random double array", bench::measure([&]() {
+        bench::do_not_optimize(jtypes::to_json(a));
+    }));
+    
+    return 0;
+}
@@ -0,0 +1,72 @@
+/**
+    This file is part of jtypes.
+
+    Copyright(C) 2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of MIT license. See the LICENSE file for details.
+*/
+
+#include "bench.hpp"
+
+#include <jtypes/jtypes.hpp>
+
+#include <algorithm>
+#include <vector>
+
+// Iterate a large array through jtype iterators versus the underlying container.
+
+using jtypes::jtype;
+
+template<class Iter>
+std::int64_t sum(Iter first, Iter last) {
+    std::int64_t s = 0;
+    for (; first != last; ++first) {
+        s += first->template as<std::int64_t>();
+    }
+    return s;
+}
+
+int main() {
+    const int n = 1000000;
+    
+    std::vector<jtype> raw;
+    jtype x = jtype::array();
+    for (int i = 0; i < n; ++i) {
+        const std::int64_t v = (std::int64_t(i) * 7919) % n;
+        raw.push_back(v);
+        x.push_back(v);
+    }
+    const jtype &cx = x;
+    
+    bench::report("std::vector<jtype>", bench::measure([&]() {
+        bench::do_not_optimize(sum(raw.cbegin(), raw.cend()));
+    }, 20));
+    
+    bench::report("begin() / end()", bench::measure([&]() {
+        bench::do_not_optimize(sum(cx.begin(), cx.end()));
+    }, 20));
+    
+    bench::report("index access", bench::measure([&]() {
+        std::int64_t s = 0;
+        for (int i = 0; i < n; ++i) {
+            s += cx[i].as<std::int64_t>();
+        }
+        bench::do_not_optimize(s);
+    }, 20));
+    
+    bench::report("elements()", bench::measure([&]() {
+        auto e = cx.elements();
+        bench::do_not_optimize(sum(e.begin(), e.end()));
+    }, 20));
+    
+    bench::report("std::sort elements()", bench::measure([&]() {
+        jtype y = x;
+        auto e = y.elements();
+        std::sort(e.begin(), e.end());
+        bench::do_not_optimize(y);
+    }, 5));
+    
+    return 0;
+}
@@ -0,0 +1,49 @@
+/**
+    This file is part of jtypes.
+
+    Copyright(C) 2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of MIT license. See the LICENSE file for details.
+*/
+
+#include "bench.hpp"
+
+#include <jtypes/jtypes.hpp>
+
+// Allocations per property lookup by string literal, std::string and jtype key.
+// Build with JTYPES_COMPACT_STORAGE or JTYPES_INTERN_KEYS to compare storage options.
+
+using jtypes::jtype;
+
+template<class F>
+void run(const std::string &name, F f) {
+    const int n = 1000000;
+    bench::result r = bench::measure(f, n);
+    std::printf("%-48s %12.1f ns %14.2f allocs/lookup\n", name.c_str(), r.ms * 1e6, double(r.allocs));
+}
+
+int main() {
+    jtype x = jtype::object();
+    for (int i = 0; i < 16; ++i) {
+        x["property_" + std::to_string(i)] = i;
+    }
+    x["id"] = 1;
+    x["a_property_name_beyond_sso"] = 2;
+    
+    const jtype &cx = x;
+    const std::string short_key = "id";
+    const std::string long_key = "a_property_name_beyond_sso";
+    const jtype short_jkey = short_key;
+    
+    run("const literal short", [&]() { bench::do_not_optimize(cx["id"]); });
+    run("const literal long", [&]() { bench::do_not_optimize(cx["a_property_name_beyond_sso"]); });
+    run("const std::string short", [&]() { bench::do_not_optimize(cx[short_key]); });
+    run("const std::string long", [&]() { bench::do_not_optimize(cx[long_key]); });
+    run("const jtype short", [&]() { bench::do_not_optimize(cx[short_jkey]); });
+    run("non-const literal short", [&]() { bench::do_not_optimize(x["id"]); });
+    run("non-const std::string long", [&]() { bench::do_not_optimize(x[long_key]); });
+    
+    return 0;
+}
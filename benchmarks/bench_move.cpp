@@ -0,0 +1,76 @@
+/**
+    This file is part of jtypes.
+
+    Copyright(C) 2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of MIT license. See the LICENSE file for details.
+*/
+
+#include "bench.hpp"
+
+#include <jtypes/jtypes.hpp>
+#include <jtypes/jtypes_io.hpp>
+
+using jtypes::jtype;
+
+static jtype make_record(int i) {
+    return jtype::object{
+        {"id", i},
+        {"label", "a label long enough to defeat small string optimization"},
+        {"tags", jtype::array{"a", "b", "c"}},
+        {"dims", jtype::object{{"width", 10}, {"height", 2.0}}}
+    };
+}
+
+int main() {
+    const int n = 100000;
+    
+    bench::report("build array, push_back(const jtype&)", bench::measure([&]() {
+        jtype a = jtype::array();
+        for (int i = 0; i < n; ++i) {
+            const jtype r = make_record(i);
+            a.push_back(r);
+        }
+        bench::do_not_optimize(a);
+    }));
+    
+    bench::report("build array, push_back(jtype&&)", bench::measure([&]() {
+        jtype a = jtype::array();
+        for (int i = 0; i < n; ++i) {
+            a.push_back(make_record(i));
+        }
+        bench::do_not_optimize(a);
+    }));
+    
+    bench::report("build object, assign copy", bench::measure([&]() {
+        jtype o = jtype::object();
+        for (int i = 0; i < n; ++i) {
+            const jtype r = make_record(i);
+            o[std::to_string(i)] = r;
+        }
+        bench::do_not_optimize(o);
+    }));
+    
+    bench::report("build object, assign move", bench::measure([&]() {
+        jtype o = jtype::object();
+        for (int i = 0; i < n; ++i) {
+            o[std::to_string(i)] = make_record(i);
+        }
+        bench::do_not_optimize(o);
+    }));
+    
+    jtype doc = jtype::array();
+    for (int i = 0; i < n; ++i) {
+        doc.push_back(make_record(i));
+    }
+    const std::string json = jtypes::to_json(doc);
+    
+    bench::report("from_json", bench::measure([&]() {
+        jtype x = jtypes::from_json(json);
+        bench::do_not_optimize(x);
+    }));
+    
+    return 0;
+}
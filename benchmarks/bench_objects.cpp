@@ -0,0 +1,63 @@
+/**
+    This file is part of jtypes.
+
+    Copyright(C) 2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of MIT license. See the LICENSE file for details.
+*/
+
+#include "bench.hpp"
+
+#include <jtypes/jtypes.hpp>
+
+// Compare std::map against the open addressing map behind JTYPES_HASH_OBJECTS.
+
+using jtypes::jtype;
+
+template<class Map>
+void run(const std::string &name, const std::vector<std::string> &keys) {
+    const int repetitions = std::max<int>(1, int(1000000 / keys.size()));
+    const std::string suffix = " " + name + " n=" + std::to_string(keys.size());
+
+    Map m;
+    bench::report("insert" + suffix, bench::measure([&]() {
+        m = Map();
+        for (auto && k : keys) {
+            m.emplace(k, jtype(1));
+        }
+    }, repetitions));
+
+    bench::report("lookup" + suffix, bench::measure([&]() {
+        std::size_t hits = 0;
+        for (auto && k : keys) {
+            hits += m.count(k);
+        }
+        bench::do_not_optimize(hits);
+    }, repetitions));
+
+    bench::report("iterate" + suffix, bench::measure([&]() {
+        std::int64_t sum = 0;
+        for (auto && p : m) {
+            sum += p.second.template as<std::int64_t>();
+        }
+        bench::do_not_optimize(sum);
+    }, repetitions));
+}
+
+int main() {
+    const std::size_t sizes[] = {4, 16, 64, 256, 1024, 10000, 100000};
+
+    for (auto n : sizes) {
+        std::vector<std::string> keys;
+        for (std::size_t i = 0; i < n; ++i) {
+            keys.push_back("property_" + std::to_string(i * 7919));
+        }
+
+        run<std::map<jtypes::details::object_key, jtype> >("map", keys);
+        run<jtypes::details::flat_map<jtypes::details::object_key, jtype> >("hash", keys);
+    }
+
+    return 0;
+}
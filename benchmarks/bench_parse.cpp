@@ -0,0 +1,66 @@
+/**
+    This file is part of jtypes.
+
+    Copyright(C) 2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of MIT license. See the LICENSE file for details.
+*/
+
+#include "bench.hpp"
+
+#include <jtypes/jtypes.hpp>
+#include <jtypes/jtypes_io.hpp>
+
+// Peak memory and allocations of from_json through the json parser versus parsing directly.
+
+using jtypes::jtype;
+
+std::string make_input() {
+    std::string s = "[";
+    for (int i = 0; i < 50000; ++i) {
+        if (i > 0) s += ",";
+        s += "{\"id\":" + std::to_string(i) + ",\"text\":\"" + std::string(200, 'a' + i % 26) + "\",\"tags\":[\"alpha-" + std::to_string(i) + "\",\"beta\"]}";
+    }
+    s += "]";
+    return s;
+}
+
+template<class F>
+void run(const std::string &name, F f) {
+    std::string input = make_input();
+    const std::size_t base = bench::live_bytes();
+    bench::peak_bytes() = base;
+    
+    bench::result r = bench::measure([&]() {
+        jtype v = f(input);
+        bench::do_not_optimize(v);
+    });
+    
+    bench::report(name, r);
+    bench::report_memory(name + " peak", bench::peak_bytes() - base);
+}
+
+int main() {
+    bench::report_memory("input", make_input().size());
+    
+    run("copy from json", [](std::string &input) {
+        jtypes::json j = jtypes::json::parse(input);
+        return jtypes::details::from_json(static_cast<const jtypes::json&>(j));
+    });
+    
+    run("consume json", [](std::string &input) {
+        return jtypes::from_json(static_cast<const std::string&>(input));
+    });
+    
+    run("direct from moved input", [](std::string &input) {
+        return jtypes::from_json(std::move(input));
+    });
+    
+    run("direct from buffer", [](std::string &input) {
+        return jtypes::from_json(input.data(), input.size());
+    });
+    
+    return 0;
+}
@@ -0,0 +1,54 @@
+/**
+    This file is part of jtypes.
+
+    Copyright(C) 2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of MIT license. See the LICENSE file for details.
+*/
+
+#include "bench.hpp"
+
+#include <jtypes/jtypes.hpp>
+
+// Resolve nested properties through dotted strings versus compiled paths and pointers.
+
+using jtypes::jtype;
+
+int main() {
+    jtype doc = jtype::object();
+    for (int i = 0; i < 16; ++i) {
+        doc.at("config.section_" + std::to_string(i) + ".value") = i;
+    }
+    const jtype &cdoc = doc;
+    const int n = 100000;
+    
+    bench::report("at(string)", bench::measure([&]() {
+        std::int64_t sum = 0;
+        for (int i = 0; i < n; ++i) {
+            sum += cdoc.at("config.section_7.value").as<std::int64_t>();
+        }
+        bench::do_not_optimize(sum);
+    }));
+    
+    const jtype::path p("config.section_7.value");
+    bench::report("at(path)", bench::measure([&]() {
+        std::int64_t sum = 0;
+        for (int i = 0; i < n; ++i) {
+            sum += cdoc.at(p).as<std::int64_t>();
+        }
+        bench::do_not_optimize(sum);
+    }));
+    
+    const jtype::pointer ptr("/config/section_7/value");
+    bench::report("at(pointer)", bench::measure([&]() {
+        std::int64_t sum = 0;
+        for (int i = 0; i < n; ++i) {
+            sum += cdoc.at(ptr).as<std::int64_t>();
+        }
+        bench::do_not_optimize(sum);
+    }));
+    
+    return 0;
+}
@@ -0,0 +1,56 @@
+/**
+    This file is part of jtypes.
+
+    Copyright(C) 2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of MIT license. See the LICENSE file for details.
+*/
+
+#include "bench.hpp"
+
+#include <jtypes/jtypes.hpp>
+
+// Coercion of large and nested arrays to string.
+
+using jtypes::jtype;
+
+// Array of fanout^depth numbers nested depth levels deep.
+jtype make_nested(int depth, int fanout, int &counter) {
+    jtype a = jtype::array();
+    for (int i = 0; i < fanout; ++i) {
+        if (depth > 1) {
+            a.push_back(make_nested(depth - 1, fanout, counter));
+        } else {
+            a.push_back(counter++ * 0.25);
+        }
+    }
+    return a;
+}
+
+int main() {
+    int counter = 0;
+    jtype flat = jtype::array();
+    for (int i = 0; i < 1000000; ++i) {
+        flat.push_back(i);
+    }
+    const jtype nested = make_nested(6, 10, counter);
+    
+    bench::report("as<std::string>() flat 1M ints", bench::measure([&]() {
+        bench::do_not_optimize(flat.as<std::string>());
+    }, 5));
+    
+    bench::report("as<std::string>() nested 10^6 doubles", bench::measure([&]() {
+        bench::do_not_optimize(nested.as<std::string>());
+    }, 5));
+    
+    std::string buffer;
+    bench::report("append_string() nested, reused buffer", bench::measure([&]() {
+        buffer.clear();
+        jtypes::append_string(nested, buffer);
+        bench::do_not_optimize(buffer);
+    }, 5));
+    
+    return 0;
+}
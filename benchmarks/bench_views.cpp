@@ -0,0 +1,75 @@
+/**
+    This file is part of jtypes.
+
+    Copyright(C) 2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of MIT license. See the LICENSE file for details.
+*/
+
+#include "bench.hpp"
+
+#include <jtypes/jtypes.hpp>
+
+// Iterate keys and values of a large object through materialized arrays versus lazy views.
+
+using jtypes::jtype;
+
+int main() {
+    jtype::object_t o;
+    for (int i = 0; i < 1000000; ++i) {
+        o.emplace("a_longer_property_name_" + std::to_string(i), i);
+    }
+    const jtype x = jtype(std::move(o));
+    
+    bench::report("keys()", bench::measure([&]() {
+        std::size_t n = 0;
+        for (auto && k : x.keys()) {
+            n += k.as<std::string>().size();
+        }
+        bench::do_not_optimize(n);
+    }));
+    
+    bench::report("keys_view()", bench::measure([&]() {
+        std::size_t n = 0;
+        for (auto && k : x.keys_view()) {
+            n += k.name().size();
+        }
+        bench::do_not_optimize(n);
+    }));
+    
+    bench::report("values()", bench::measure([&]() {
+        std::int64_t sum = 0;
+        for (auto && v : x.values()) {
+            sum += v.as<std::int64_t>();
+        }
+        bench::do_not_optimize(sum);
+    }));
+    
+    bench::report("values_view()", bench::measure([&]() {
+        std::int64_t sum = 0;
+        for (auto && v : x.values_view()) {
+            sum += v.as<std::int64_t>();
+        }
+        bench::do_not_optimize(sum);
+    }));
+    
+    bench::report("iterator key()", bench::measure([&]() {
+        std::size_t n = 0;
+        for (auto iter = x.begin(); iter != x.end(); ++iter) {
+            n += iter.key().as<std::string>().size();
+        }
+        bench::do_not_optimize(n);
+    }));
+    
+    bench::report("items()", bench::measure([&]() {
+        std::size_t n = 0;
+        for (auto && kv : x.items()) {
+            n += kv.key.name().size() + std::size_t(kv.value.as<std::int64_t>());
+        }
+        bench::do_not_optimize(n);
+    }));
+    
+    return 0;
+}
@@ -26,11 +26,28 @@
 #include <vector>
 #include <map>
 #include <cstdint>
+#include <cstdlib>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
 #include <type_traits>
 #include <utility>
 #include <stdexcept>
 #include <functional>
+#include <memory>
+#include <sstream>
+#include <mutex>
+#include <unordered_set>
+#include <algorithm>
+#include <initializer_list>
+#include <atomic>
 
+// Copy-on-write sharing is implemented by the compact storage engine.
+#if defined(JTYPES_COPY_ON_WRITE) && !defined(JTYPES_COMPACT_STORAGE)
+#define JTYPES_COMPACT_STORAGE
+#endif
 
 namespace jtypes {
 
@@ -86,6 +103,352 @@ namespace jtypes {
         
     };
     
+    /**
+        Value that may be absent, returned by the non-throwing accessors of jtype.
+    */
+    template<typename T>
+    class optional {
+    public:
+        optional()
+        : _has_value(false), _value() {
+        }
+        
+        optional(T value)
+        : _has_value(true), _value(std::move(value)) {
+        }
+        
+        bool has_value() const { return _has_value; }
+        explicit operator bool() const { return _has_value; }
+        
+        T &operator*() { return _value; }
+        const T &operator*() const { return _value; }
+        T *operator->() { return &_value; }
+        const T *operator->() const { return &_value; }
+        
+        const T &value() const {
+            if (!_has_value) {
+                throw type_error("optional has no value");
+            }
+            return _value;
+        }
+        
+        T value_or(T default_value) const { return _has_value ? _value : std::move(default_value); }
+        
+    private:
+        bool _has_value;
+        T _value;
+    };
+    
+    /**
+        Reason why try_as() could not convert a value.
+    */
+    enum class coerce_error {
+        none,
+        invalid_type,       // the stored type does not convert, e.g. an object to a number
+        invalid_number,     // a string that is not a numeric literal
+        out_of_range        // a number that the requested type cannot represent
+    };
+    
+    /**
+        Key of an array element or object property.
+     
+        Refers to the stored property name instead of copying it and is valid as long
+        as the property exists. Converts to a jtype holding the index or name.
+    */
+    class key_ref {
+    public:
+        explicit key_ref(std::uint64_t index)
+        : _name(nullptr), _index(index) {
+        }
+        
+        explicit key_ref(const std::string &name)
+        : _name(&name), _index(0) {
+        }
+        
+        bool is_index() const { return _name == nullptr; }
+        
+        std::uint64_t index() const {
+            if (!is_index()) {
+                throw type_error("index() requires an array element key");
+            }
+            return _index;
+        }
+        
+        const std::string &name() const {
+            if (is_index()) {
+                throw type_error("name() requires an object property key");
+            }
+            return *_name;
+        }
+        
+        operator jtype() const;
+        
+    private:
+        const std::string *_name;
+        std::uint64_t _index;
+    };
+    
+    namespace details {
+        
+        // Forward range over [begin, end).
+        template<typename Iterator>
+        class range {
+        public:
+            using iterator = Iterator;
+            
+            range(Iterator first, Iterator last)
+            : _first(first), _last(last) {
+            }
+            
+            Iterator begin() const { return _first; }
+            Iterator end() const { return _last; }
+            bool empty() const { return _first == _last; }
+            
+        private:
+            Iterator _first, _last;
+        };
+        
+        // Iterator that yields Projection()(iter) for each position of the underlying iterator.
+        template<typename Iterator, typename Projection>
+        class projected_iterator : public std::iterator<std::forward_iterator_tag, typename Projection::value_type, std::ptrdiff_t, void, typename Projection::value_type> {
+        public:
+            projected_iterator() {}
+            
+            explicit projected_iterator(const Iterator &iter)
+            : _iter(iter) {
+            }
+            
+            typename Projection::value_type operator*() const { return Projection()(_iter); }
+            
+            projected_iterator &operator++() { ++_iter; return *this; }
+            projected_iterator operator++(int) { projected_iterator tmp(*this); ++_iter; return tmp; }
+            
+            bool operator==(const projected_iterator &rhs) const { return _iter == rhs._iter; }
+            bool operator!=(const projected_iterator &rhs) const { return !(_iter == rhs._iter); }
+            
+        private:
+            Iterator _iter;
+        };
+        
+        struct key_projection {
+            using value_type = key_ref;
+            
+            template<class Iterator>
+            key_ref operator()(const Iterator &iter) const { return iter.key_ref(); }
+        };
+        
+        template<typename Type>
+        struct item_projection {
+            struct value_type {
+                key_ref key;
+                Type &value;
+            };
+            
+            template<class Iterator>
+            value_type operator()(const Iterator &iter) const { return value_type{iter.key_ref(), *iter}; }
+        };
+    }
+    
+    
+    class atom_table;
+    
+    /**
+        Interned property name.
+     
+        An atom references a string owned by an atom_table. Atoms of equal content
+        created through the same table share storage, so comparing them is a pointer
+        comparison. When JTYPES_INTERN_KEYS is defined object_t stores its keys as
+        atoms.
+    */
+    class atom {
+    public:
+        atom();
+        atom(const char *s);
+        atom(const std::string &s);
+        
+        // Reference s without interning. For lookups only, must not outlive s.
+        static atom unowned(const std::string &s);
+        
+        const std::string &str() const { return *_s; }
+        operator const std::string&() const { return *_s; }
+        
+        std::size_t hash() const { return _hash; }
+        
+        friend bool operator==(const atom &lhs, const atom &rhs) { return lhs._s == rhs._s || (lhs._hash == rhs._hash && *lhs._s == *rhs._s); }
+        friend bool operator!=(const atom &lhs, const atom &rhs) { return !(lhs == rhs); }
+        friend bool operator<(const atom &lhs, const atom &rhs) { return lhs._s != rhs._s && *lhs._s < *rhs._s; }
+        
+    private:
+        friend class atom_table;
+        
+        explicit atom(const std::string *s)
+        : _s(s), _hash(std::hash<std::string>()(*s)) {
+        }
+        
+        const std::string *_s;
+        std::size_t _hash;
+    };
+    
+    /**
+        Thread-safe table of interned strings.
+     
+        Atoms are created in the table that is current for the calling thread, which
+        is the global table unless a scope is active. A scoped table, e.g. one per
+        document, must outlive every atom interned while it was active.
+    */
+    class atom_table {
+    public:
+        atom_table() = default;
+        atom_table(const atom_table &) = delete;
+        atom_table &operator=(const atom_table &) = delete;
+        
+        atom intern(const std::string &s) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return atom(&*_strings.insert(s).first);
+        }
+        
+        std::size_t size() const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _strings.size();
+        }
+        
+        static atom_table &global() {
+            static atom_table t;
+            return t;
+        }
+        
+        static atom_table &current() {
+            atom_table *t = scoped();
+            return t ? *t : global();
+        }
+        
+        // Makes a table current for the calling thread during the lifetime of the scope.
+        class scope {
+        public:
+            explicit scope(atom_table &t)
+            : _prev(scoped()) {
+                scoped() = &t;
+            }
+            
+            ~scope() {
+                scoped() = _prev;
+            }
+            
+            scope(const scope &) = delete;
+            scope &operator=(const scope &) = delete;
+            
+        private:
+            atom_table *_prev;
+        };
+        
+    private:
+        static atom_table *&scoped() {
+            static thread_local atom_table *t = nullptr;
+            return t;
+        }
+        
+        mutable std::mutex _mutex;
+        std::unordered_set<std::string> _strings;
+    };
+    
+    inline atom::atom()
+    : atom(atom_table::current().intern(std::string())) {
+    }
+    
+    inline atom::atom(const char *s)
+    : atom(atom_table::current().intern(s)) {
+    }
+    
+    inline atom::atom(const std::string &s)
+    : atom(atom_table::current().intern(s)) {
+    }
+    
+    inline atom atom::unowned(const std::string &s) {
+        return atom(&s);
+    }
+    
+    /**
+        Monotonic memory arena for array and object storage.
+     
+        When JTYPES_ARENA_ALLOCATION is defined, arrays and objects created while a
+        scope is active on the calling thread allocate their elements from the arena.
+        Deallocation is a no-op and all memory is released at once when the arena is
+        destroyed, so the arena must outlive every jtype created in its scope. Copies
+        allocate from the arena that is current at the time of copying. Strings and
+        functions are not affected. An arena is not thread-safe.
+    */
+    class arena {
+    public:
+        explicit arena(std::size_t block_size = 64 * 1024)
+        : _block_size(block_size), _cur(nullptr), _left(0), _size(0) {
+        }
+        
+        ~arena() {
+            for (auto b : _blocks) {
+                ::operator delete(b);
+            }
+        }
+        
+        arena(const arena &) = delete;
+        arena &operator=(const arena &) = delete;
+        
+        void *allocate(std::size_t n, std::size_t align) {
+            std::size_t pad = (align - reinterpret_cast<std::uintptr_t>(_cur) % align) % align;
+            if (pad + n > _left) {
+                std::size_t bytes = std::max(_block_size, n + align);
+                _cur = static_cast<char*>(::operator new(bytes));
+                _blocks.push_back(_cur);
+                _left = bytes;
+                pad = (align - reinterpret_cast<std::uintptr_t>(_cur) % align) % align;
+            }
+            
+            void *p = _cur + pad;
+            _cur += pad + n;
+            _left -= pad + n;
+            _size += n;
+            return p;
+        }
+        
+        // Number of bytes handed out so far.
+        std::size_t size() const { return _size; }
+        
+        // Arena of the innermost scope on the calling thread, null if none is active.
+        static arena *current() {
+            return scoped();
+        }
+        
+        // Makes an arena current for the calling thread during the lifetime of the scope.
+        class scope {
+        public:
+            explicit scope(arena &a)
+            : _prev(scoped()) {
+                scoped() = &a;
+            }
+            
+            ~scope() {
+                scoped() = _prev;
+            }
+            
+            scope(const scope &) = delete;
+            scope &operator=(const scope &) = delete;
+            
+        private:
+            arena *_prev;
+        };
+        
+    private:
+        static arena *&scoped() {
+            static thread_local arena *a = nullptr;
+            return a;
+        }
+        
+        std::size_t _block_size;
+        std::vector<char*> _blocks;
+        char *_cur;
+        std::size_t _left;
+        std::size_t _size;
+    };
+    
     namespace meta {
         template<typename T, typename R = void>
         using if_is_signed_integral = typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, R>::type;
@@ -113,6 +476,17 @@ namespace jtypes {
         
         template <typename R, typename... Args>
         struct result_of_sig<R(Args...)> { using type = R; };
+        
+        template<typename T, typename R = void>
+        using if_is_atom = typename std::enable_if<std::is_same<T, atom>::value, R>::type;
+        
+        template<typename T, typename R = void>
+        using if_is_string = typename std::enable_if<std::is_same<typename std::decay<T>::type, std::string>::value, R>::type;
+        
+        template<typename T, typename U>
+        using are_number_t = std::integral_constant<bool,
+            (std::is_same<T, std::int64_t>::value || std::is_same<T, std::uint64_t>::value || std::is_same<T, double>::value) &&
+            (std::is_same<U, std::int64_t>::value || std::is_same<U, std::uint64_t>::value || std::is_same<U, double>::value)>;
     }
     
     namespace details {
@@ -191,98 +565,973 @@ namespace jtypes {
         inline bool operator==(const undefined_t &lhs, const undefined_t &rhs) { return true; }
         inline bool operator<(const undefined_t &lhs, const undefined_t &rhs) { return false; }
         
-    }
-
-    
-    class jtype {
-    public:
-        enum class vtype {
-            undefined = 0,
-            null,
-            boolean,
-            signed_number,
-            unsigned_number,
-            real_number,
-            string,
-            function,
-            array,
-            object,
-        };
-        
-        using undefined_t = details::undefined_t ;
-        using null_t = std::nullptr_t ;
-        using number_t = variant<std::int64_t, std::uint64_t, double>;
-        using function_t = details::fnc_holder;
-        using array_t = std::vector<jtype>;
-        using object_t = std::map<std::string, jtype>;
-
-        using iterator = details::var_iterator<jtype>;
-        using const_iterator = details::var_iterator<jtype const>;
-        using value_type = jtype;
-
-
-        using null = null_t;
-        using undefined = undefined_t;
-        using object = object_t;
-        using array = array_t;
-        
-        // Value initializers
-        
-        jtype();
-        
-        jtype(std::nullptr_t);
-        
-        jtype(bool v);
-        
-        template<typename I>
-        jtype(I t, typename meta::if_is_signed_integral<I>* unused = 0);
-        
-        template<typename I>
-        jtype(I t, typename meta::if_is_unsigned_integral<I>* unused = 0);
-        
-        template<typename I>
-        jtype(I t, typename meta::if_is_real<I>* unused = 0);
-        
-        jtype(char v);
-        
-        jtype(const char* v);
+#if defined(JTYPES_INTERN_KEYS)
+        using object_key = atom;
+#else
+        using object_key = std::string;
+#endif
         
-        jtype(const std::string &v);
+        /**
+            Allocator bound to the arena that was current when it was created.
+         
+            Falls back to the global heap when no arena scope is active. Containers that
+            are copied rebind to the arena current at the time of the copy.
+        */
+        template<typename T>
+        class arena_allocator {
+        public:
+            using value_type = T;
+            using propagate_on_container_move_assignment = std::true_type;
+            using propagate_on_container_swap = std::true_type;
+            
+            arena_allocator()
+            : _arena(arena::current()) {
+            }
+            
+            template<typename U>
+            arena_allocator(const arena_allocator<U> &other)
+            : _arena(other.get_arena()) {
+            }
+            
+            T *allocate(std::size_t n) {
+                if (_arena) {
+                    return static_cast<T*>(_arena->allocate(n * sizeof(T), alignof(T)));
+                }
+                return static_cast<T*>(::operator new(n * sizeof(T)));
+            }
+            
+            void deallocate(T *p, std::size_t) {
+                if (!_arena) {
+                    ::operator delete(p);
+                }
+            }
+            
+            arena_allocator select_on_container_copy_construction() const {
+                return arena_allocator();
+            }
+            
+            arena *get_arena() const { return _arena; }
+            
+            template<typename U>
+            bool operator==(const arena_allocator<U> &rhs) const { return _arena == rhs.get_arena(); }
+            
+            template<typename U>
+            bool operator!=(const arena_allocator<U> &rhs) const { return _arena != rhs.get_arena(); }
+            
+        private:
+            arena *_arena;
+        };
         
-        jtype(std::string &&v);
-
-        jtype(const undefined_t &v);
-        jtype(undefined_t &&v);
-
-        // Function initializers
-        template<class Sig, typename = meta::if_is_function<Sig> >
-        static jtype function(std::function<Sig> && v = std::function<Sig>());
-
-        jtype(const function_t &v);
-        jtype(function_t &&v);
-
-        // Array initializers
+#if defined(JTYPES_ARENA_ALLOCATION)
+        template<typename T>
+        using node_allocator = arena_allocator<T>;
+#else
+        template<typename T>
+        using node_allocator = std::allocator<T>;
+#endif
         
-        jtype(const array_t &v);
-        jtype(array_t &&v);
+        struct key_hash {
+            std::size_t operator()(const std::string &k) const { return std::hash<std::string>()(k); }
+            std::size_t operator()(const atom &k) const { return k.hash(); }
+        };
         
-        // Dictionary initializers
-
-        jtype(const object_t &v);
-        jtype(object_t &&v);
-
-        // Assignments
-
-        jtype &operator=(const jtype &rhs) = default;
-        jtype &operator=(std::nullptr_t);
-        jtype &operator=(bool rhs);
-        jtype &operator=(char rhs);
-        jtype &operator=(const char* v);
-        jtype &operator=(const std::string &rhs);
-
-        template<typename I>
-        meta::if_is_signed_integral<I, jtype&>
-            operator=(I t);
+        /**
+            Open addressing hash map using Robin Hood probing.
+         
+            Entries are stored densely and iterate in insertion order. The index table
+            holds for each entry its position and the lower 32 bits of its hash, so
+            probing rarely touches the entries and growing never rehashes keys. Used
+            as jtype::object_t when JTYPES_HASH_OBJECTS is defined.
+         
+            Maps with up to small_size entries have no index table at all. Keys are
+            found by a linear scan over the entries, so a small object costs a single
+            allocation. The index is built once the map grows beyond that size.
+        */
+        template<typename Key, typename T, typename Hash = key_hash, typename Allocator = std::allocator<std::pair<Key, T> > >
+        class flat_map {
+        public:
+            using key_type = Key;
+            using mapped_type = T;
+            using value_type = std::pair<Key, T>;
+            using size_type = std::size_t;
+            using hasher = Hash;
+            using allocator_type = Allocator;
+            using iterator = typename std::vector<value_type, Allocator>::iterator;
+            using const_iterator = typename std::vector<value_type, Allocator>::const_iterator;
+            
+            static const size_type small_size = 8;
+            
+            flat_map()
+            : _mask(0) {
+            }
+            
+            flat_map(std::initializer_list<value_type> init)
+            : _mask(0) {
+                insert(init.begin(), init.end());
+            }
+            
+            template<class Iter>
+            flat_map(Iter first, Iter last)
+            : _mask(0) {
+                insert(first, last);
+            }
+            
+            iterator begin() { return _entries.begin(); }
+            iterator end() { return _entries.end(); }
+            const_iterator begin() const { return _entries.begin(); }
+            const_iterator end() const { return _entries.end(); }
+            
+            size_type size() const { return _entries.size(); }
+            bool empty() const { return _entries.empty(); }
+            
+            allocator_type get_allocator() const { return _entries.get_allocator(); }
+            
+            void clear() {
+                _entries.clear();
+                _slots.clear();
+                _mask = 0;
+            }
+            
+            void reserve(size_type n) {
+                _entries.reserve(n);
+                if (n > small_size) {
+                    size_type cap = capacity_for(n);
+                    if (cap > _slots.size()) rehash(cap);
+                }
+            }
+            
+            iterator find(const Key &k) {
+                size_type i = index_of(k);
+                return i == npos ? end() : begin() + i;
+            }
+            
+            const_iterator find(const Key &k) const {
+                size_type i = index_of(k);
+                return i == npos ? end() : begin() + i;
+            }
+            
+            // Find that tries the entry at position hint first and updates hint on success.
+            iterator find(const Key &k, size_type &hint) {
+                size_type i = index_of(k, hint);
+                return i == npos ? end() : begin() + i;
+            }
+            
+            const_iterator find(const Key &k, size_type &hint) const {
+                size_type i = index_of(k, hint);
+                return i == npos ? end() : begin() + i;
+            }
+            
+            size_type count(const Key &k) const {
+                return index_of(k) == npos ? 0 : 1;
+            }
+            
+            // The key is looked up before a copy of it is made, so an existing key costs no construction.
+            template<class K, class V>
+            std::pair<iterator, bool> emplace(K &&k, V &&v) {
+                return emplace_key(std::forward<K>(k), std::forward<V>(v), std::is_same<typename std::decay<K>::type, Key>());
+            }
+            
+            std::pair<iterator, bool> insert(const value_type &v) { return emplace(v.first, v.second); }
+            std::pair<iterator, bool> insert(value_type &&v) { return emplace(std::move(v.first), std::move(v.second)); }
+            
+            template<class Iter>
+            void insert(Iter first, Iter last) {
+                for (; first != last; ++first) insert(*first);
+            }
+            
+            T &operator[](const Key &k) {
+                size_type i = index_of(k);
+                return i == npos ? append(k, T())->second : _entries[i].second;
+            }
+            
+            T &at(const Key &k) {
+                size_type i = index_of(k);
+                if (i == npos) throw std::out_of_range("flat_map::at() key not found");
+                return _entries[i].second;
+            }
+            
+            const T &at(const Key &k) const {
+                size_type i = index_of(k);
+                if (i == npos) throw std::out_of_range("flat_map::at() key not found");
+                return _entries[i].second;
+            }
+            
+            size_type erase(const Key &k) {
+                if (_slots.empty()) {
+                    size_type i = index_of(k);
+                    if (i == npos) return 0;
+                    _entries.erase(_entries.begin() + i);
+                    return 1;
+                }
+                
+                size_type pos = slot_of(k);
+                if (pos == npos) return 0;
+                
+                // Backward shift deletion, then close the gap in the dense entries.
+                const size_type i = _slots[pos].index - 1;
+                size_type next = (pos + 1) & _mask;
+                while (_slots[next].index != 0 && distance(next) > 0) {
+                    _slots[pos] = _slots[next];
+                    pos = next;
+                    next = (next + 1) & _mask;
+                }
+                _slots[pos] = slot();
+                
+                // Only the entries behind the erased one move down a position.
+                for (size_type j = i + 1; j < _entries.size(); ++j) {
+                    --_slots[slot_of_index(j)].index;
+                }
+                _entries.erase(_entries.begin() + i);
+                return 1;
+            }
+            
+            friend bool operator==(const flat_map &lhs, const flat_map &rhs) {
+                if (lhs.size() != rhs.size()) return false;
+                for (auto && e : lhs) {
+                    auto iter = rhs.find(e.first);
+                    if (iter == rhs.end() || !(iter->second == e.second)) return false;
+                }
+                return true;
+            }
+            
+            friend bool operator!=(const flat_map &lhs, const flat_map &rhs) { return !(lhs == rhs); }
+            
+        private:
+            static const size_type npos = size_type(-1);
+            
+            struct slot {
+                std::uint32_t frag;
+                std::uint32_t index; // entry position + 1, zero marks an empty slot.
+                slot() : frag(0), index(0) {}
+            };
+            
+            std::uint32_t fragment(const Key &k) const { return static_cast<std::uint32_t>(Hash()(k)); }
+            
+            size_type distance(size_type pos) const { return (pos - (_slots[pos].frag & _mask)) & _mask; }
+            
+            static size_type capacity_for(size_type n) {
+                size_type cap = 16;
+                while (n * 5 > cap * 4) cap *= 2;
+                return cap;
+            }
+            
+            size_type index_of(const Key &k) const {
+                if (_slots.empty()) {
+                    for (size_type i = 0; i < _entries.size(); ++i) {
+                        if (_entries[i].first == k) return i;
+                    }
+                    return npos;
+                }
+                
+                size_type pos = slot_of(k);
+                return pos == npos ? npos : _slots[pos].index - 1;
+            }
+            
+            size_type index_of(const Key &k, size_type &hint) const {
+                if (hint < _entries.size() && _entries[hint].first == k) return hint;
+                
+                size_type i = index_of(k);
+                if (i != npos) hint = i;
+                return i;
+            }
+            
+            size_type slot_of(const Key &k) const {
+                const std::uint32_t frag = fragment(k);
+                size_type pos = frag & _mask;
+                for (size_type dist = 0; ; ++dist, pos = (pos + 1) & _mask) {
+                    const slot &s = _slots[pos];
+                    if (s.index == 0 || distance(pos) < dist) return npos;
+                    if (s.frag == frag && _entries[s.index - 1].first == k) return pos;
+                }
+            }
+            
+            // Slot referring to the entry at position i, which must be indexed.
+            size_type slot_of_index(size_type i) const {
+                size_type pos = fragment(_entries[i].first) & _mask;
+                while (_slots[pos].index != i + 1) pos = (pos + 1) & _mask;
+                return pos;
+            }
+            
+            template<class K, class V>
+            std::pair<iterator, bool> emplace_key(K &&k, V &&v, std::true_type) {
+                size_type i = index_of(k);
+                if (i != npos) {
+                    return std::make_pair(begin() + i, false);
+                }
+                return std::make_pair(append(std::forward<K>(k), std::forward<V>(v)), true);
+            }
+            
+            template<class K, class V>
+            std::pair<iterator, bool> emplace_key(K &&k, V &&v, std::false_type) {
+                return emplace_key(Key(std::forward<K>(k)), std::forward<V>(v), std::true_type());
+            }
+            
+            // Appends an entry for a key known to be absent.
+            template<class K, class V>
+            iterator append(K &&k, V &&v) {
+                if (_slots.empty()) {
+                    if (_entries.capacity() == 0) _entries.reserve(small_size / 2);
+                    _entries.emplace_back(std::forward<K>(k), std::forward<V>(v));
+                    if (_entries.size() > small_size) {
+                        rehash(capacity_for(_entries.size()));
+                    }
+                } else {
+                    const std::uint32_t frag = fragment(k);
+                    _entries.emplace_back(std::forward<K>(k), std::forward<V>(v));
+                    if (_entries.size() * 5 > _slots.size() * 4) {
+                        rehash(_slots.size() * 2);
+                    }
+                    place(frag, _entries.size() - 1);
+                }
+                return end() - 1;
+            }
+            
+            void place(std::uint32_t frag, size_type i) {
+                slot s;
+                s.frag = frag;
+                s.index = static_cast<std::uint32_t>(i + 1);
+                
+                size_type pos = frag & _mask;
+                for (size_type dist = 0; ; ++dist, pos = (pos + 1) & _mask) {
+                    if (_slots[pos].index == 0) {
+                        _slots[pos] = s;
+                        return;
+                    }
+                    size_type d = distance(pos);
+                    if (d < dist) {
+                        std::swap(_slots[pos], s);
+                        dist = d;
+                    }
+                }
+            }
+            
+            void rehash(size_type n) {
+                std::vector<slot, slot_allocator> old(n, slot(), slot_allocator(_entries.get_allocator()));
+                old.swap(_slots);
+                _mask = n - 1;
+                if (old.empty()) {
+                    for (size_type i = 0; i < _entries.size(); ++i) {
+                        place(fragment(_entries[i].first), i);
+                    }
+                } else {
+                    for (auto && s : old) {
+                        if (s.index != 0) place(s.frag, s.index - 1);
+                    }
+                }
+            }
+            
+            using slot_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<slot>;
+            
+            std::vector<value_type, Allocator> _entries;
+            std::vector<slot, slot_allocator> _slots;
+            size_type _mask;
+        };
+        
+        template<typename Key, typename T, typename Hash, typename Allocator>
+        const typename flat_map<Key, T, Hash, Allocator>::size_type flat_map<Key, T, Hash, Allocator>::small_size;
+        
+        /**
+            Vector that switches to sparse storage when resizing would create many holes.
+         
+            Dense sparse_vectors behave like std::vector. Growing by more than
+            sparse_threshold and more than the current size at once converts the
+            vector to a map from index to element, so that only present elements are
+            stored. Holes read as default constructed values. Non-const access to a
+            hole through operator[] stores the element. Non-const iterators need a
+            stored element at every position, so begin() and end() convert a sparse
+            vector back to dense storage, iterate through cbegin() and cend() to keep
+            it sparse. Otherwise a sparse vector stays sparse until it is cleared. Used
+            as jtype::array_t when JTYPES_SPARSE_ARRAYS is defined.
+        */
+        template<typename T, typename Allocator = std::allocator<T> >
+        class sparse_vector {
+        public:
+            using value_type = T;
+            using size_type = std::size_t;
+            using difference_type = std::ptrdiff_t;
+            using reference = T&;
+            using const_reference = const T&;
+            using allocator_type = Allocator;
+            
+            static const size_type sparse_threshold = 1024;
+            
+            template<typename Owner, typename Ref>
+            class basic_iterator : public std::iterator<std::random_access_iterator_tag, T, std::ptrdiff_t, typename std::remove_reference<Ref>::type*, Ref> {
+            public:
+                using pointer = typename std::remove_reference<Ref>::type*;
+                
+                basic_iterator()
+                : _owner(nullptr), _idx(0) {
+                }
+                
+                basic_iterator(Owner *owner, size_type idx)
+                : _owner(owner), _idx(idx) {
+                }
+                
+                template<typename OtherOwner, typename OtherRef>
+                basic_iterator(const basic_iterator<OtherOwner, OtherRef> &other)
+                : _owner(other.owner()), _idx(other.index()) {
+                }
+                
+                Owner *owner() const { return _owner; }
+                size_type index() const { return _idx; }
+                
+                Ref operator*() const { return (*_owner)[_idx]; }
+                pointer operator->() const { return &(*_owner)[_idx]; }
+                Ref operator[](difference_type n) const { return (*_owner)[_idx + n]; }
+                
+                basic_iterator &operator++() { ++_idx; return *this; }
+                basic_iterator &operator--() { --_idx; return *this; }
+                basic_iterator operator++(int) { basic_iterator tmp(*this); ++_idx; return tmp; }
+                basic_iterator operator--(int) { basic_iterator tmp(*this); --_idx; return tmp; }
+                basic_iterator &operator+=(difference_type n) { _idx += n; return *this; }
+                basic_iterator &operator-=(difference_type n) { _idx -= n; return *this; }
+                basic_iterator operator+(difference_type n) const { return basic_iterator(_owner, _idx + n); }
+                basic_iterator operator-(difference_type n) const { return basic_iterator(_owner, _idx - n); }
+                difference_type operator-(const basic_iterator &rhs) const { return difference_type(_idx) - difference_type(rhs._idx); }
+                
+                bool operator==(const basic_iterator &rhs) const { return _idx == rhs._idx; }
+                bool operator!=(const basic_iterator &rhs) const { return _idx != rhs._idx; }
+                bool operator<(const basic_iterator &rhs) const { return _idx < rhs._idx; }
+                bool operator>(const basic_iterator &rhs) const { return _idx > rhs._idx; }
+                bool operator<=(const basic_iterator &rhs) const { return _idx <= rhs._idx; }
+                bool operator>=(const basic_iterator &rhs) const { return _idx >= rhs._idx; }
+                
+            private:
+                Owner *_owner;
+                size_type _idx;
+            };
+            
+            using iterator = basic_iterator<sparse_vector, T&>;
+            using const_iterator = basic_iterator<const sparse_vector, const T&>;
+            
+            sparse_vector()
+            : _length(0), _is_sparse(false) {
+            }
+            
+            sparse_vector(std::initializer_list<T> init)
+            : _dense(init), _length(0), _is_sparse(false) {
+            }
+            
+            template<class Iter, class = typename std::enable_if<!std::is_integral<Iter>::value>::type>
+            sparse_vector(Iter first, Iter last)
+            : _dense(first, last), _length(0), _is_sparse(false) {
+            }
+            
+            allocator_type get_allocator() const { return _dense.get_allocator(); }
+            
+            size_type size() const { return _is_sparse ? _length : _dense.size(); }
+            bool empty() const { return size() == 0; }
+            
+            bool is_sparse() const { return _is_sparse; }
+            
+            // Number of elements actually stored, excludes holes.
+            size_type stored_size() const { return _is_sparse ? _sparse.size() : _dense.size(); }
+            
+            iterator begin() { make_dense(); return iterator(this, 0); }
+            iterator end() { make_dense(); return iterator(this, size()); }
+            const_iterator begin() const { return const_iterator(this, 0); }
+            const_iterator end() const { return const_iterator(this, size()); }
+            const_iterator cbegin() const { return begin(); }
+            const_iterator cend() const { return end(); }
+            
+            T &operator[](size_type idx) {
+                return _is_sparse ? _sparse[idx] : _dense[idx];
+            }
+            
+            const T &operator[](size_type idx) const {
+                if (!_is_sparse) {
+                    return _dense[idx];
+                }
+                auto iter = _sparse.find(idx);
+                return iter != _sparse.end() ? iter->second : hole();
+            }
+            
+            T &back() { return (*this)[size() - 1]; }
+            const T &back() const { return (*this)[size() - 1]; }
+            
+            void reserve(size_type n) {
+                if (!_is_sparse) _dense.reserve(n);
+            }
+            
+            void resize(size_type n) {
+                if (!_is_sparse) {
+                    const size_type current = _dense.size();
+                    if (n <= current || n - current <= std::max(sparse_threshold, current)) {
+                        _dense.resize(n);
+                        return;
+                    }
+                    make_sparse();
+                }
+                
+                if (n < _length) {
+                    _sparse.erase(_sparse.lower_bound(n), _sparse.end());
+                }
+                _length = n;
+            }
+            
+            void clear() {
+                _dense.clear();
+                _sparse.clear();
+                _length = 0;
+                _is_sparse = false;
+            }
+            
+            void push_back(const T &v) { emplace_back(v); }
+            void push_back(T &&v) { emplace_back(std::move(v)); }
+            
+            void pop_back() {
+                if (!_is_sparse) {
+                    _dense.pop_back();
+                    return;
+                }
+                _sparse.erase(--_length);
+            }
+            
+            iterator erase(const_iterator pos) {
+                return erase(pos, pos + 1);
+            }
+            
+            iterator erase(const_iterator first, const_iterator last) {
+                const size_type idx = first.index();
+                const size_type n = last.index() - idx;
+                if (!_is_sparse) {
+                    _dense.erase(_dense.begin() + idx, _dense.begin() + idx + n);
+                    return iterator(this, idx);
+                }
+                
+                // Shift stored elements behind the erased range.
+                auto split = _sparse.erase(_sparse.lower_bound(idx), _sparse.lower_bound(idx + n));
+                std::vector<std::pair<size_type, T> > tail;
+                for (auto iter = split; iter != _sparse.end(); ++iter) {
+                    tail.emplace_back(iter->first - n, std::move(iter->second));
+                }
+                _sparse.erase(split, _sparse.end());
+                for (auto && t : tail) {
+                    _sparse.emplace_hint(_sparse.end(), t.first, std::move(t.second));
+                }
+                _length -= n;
+                return iterator(this, idx);
+            }
+            
+            template<typename ...Args>
+            T &emplace_back(Args && ... args) {
+                if (!_is_sparse) {
+                    _dense.emplace_back(std::forward<Args>(args)...);
+                    return _dense.back();
+                }
+                return _sparse.emplace_hint(_sparse.end(), _length++, T(std::forward<Args>(args)...))->second;
+            }
+            
+            template<class Iter>
+            iterator insert(const_iterator pos, Iter first, Iter last) {
+                const size_type idx = pos.index();
+                if (!_is_sparse) {
+                    _dense.insert(_dense.begin() + idx, first, last);
+                    return iterator(this, idx);
+                }
+                
+                // Shift stored elements behind the insertion point.
+                std::vector<T> values(first, last);
+                const size_type n = values.size();
+                auto split = _sparse.lower_bound(idx);
+                std::vector<std::pair<size_type, T> > tail;
+                for (auto iter = split; iter != _sparse.end(); ++iter) {
+                    tail.emplace_back(iter->first + n, std::move(iter->second));
+                }
+                _sparse.erase(split, _sparse.end());
+                for (size_type i = 0; i < n; ++i) {
+                    _sparse.emplace_hint(_sparse.end(), idx + i, std::move(values[i]));
+                }
+                for (auto && t : tail) {
+                    _sparse.emplace_hint(_sparse.end(), t.first, std::move(t.second));
+                }
+                _length += n;
+                return iterator(this, idx);
+            }
+            
+            friend bool operator==(const sparse_vector &lhs, const sparse_vector &rhs) {
+                return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+            }
+            
+            friend bool operator!=(const sparse_vector &lhs, const sparse_vector &rhs) { return !(lhs == rhs); }
+            
+            friend bool operator<(const sparse_vector &lhs, const sparse_vector &rhs) {
+                return std::lexicographical_compare(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+            }
+            
+        private:
+            using map_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<std::pair<const size_type, T> >;
+            
+            static const T &hole() {
+                static const T value{};
+                return value;
+            }
+            
+            void make_sparse() {
+                for (size_type i = 0; i < _dense.size(); ++i) {
+                    _sparse.emplace_hint(_sparse.end(), i, std::move(_dense[i]));
+                }
+                _length = _dense.size();
+                std::vector<T, Allocator>().swap(_dense);
+                _is_sparse = true;
+            }
+            
+            void make_dense() {
+                if (!_is_sparse) return;
+                
+                _dense.resize(_length);
+                for (auto && e : _sparse) {
+                    _dense[e.first] = std::move(e.second);
+                }
+                _sparse.clear();
+                _length = 0;
+                _is_sparse = false;
+            }
+            
+            std::vector<T, Allocator> _dense;
+            std::map<size_type, T, std::less<size_type>, map_allocator> _sparse;
+            size_type _length;
+            bool _is_sparse;
+        };
+        
+        template<typename T, typename Allocator>
+        const typename sparse_vector<T, Allocator>::size_type sparse_vector<T, Allocator>::sparse_threshold;
+        
+        using ordered_map = std::map<object_key, jtype, std::less<object_key>, node_allocator<std::pair<const object_key, jtype> > >;
+        using hash_map = flat_map<object_key, jtype, key_hash, node_allocator<std::pair<object_key, jtype> > >;
+        
+        /**
+            Container choices of jtype.
+         
+            Deployments can substitute their own containers by defining JTYPES_TRAITS to a
+            template with the same signature and members before including this header.
+            array_type needs the interface of std::vector except data(), storage need not
+            be contiguous. object_type needs the find, emplace and iteration interface of
+            std::map. Value is jtype and Key the property name
+            type (std::string or atom).
+        */
+        template<typename Value, typename Key>
+        struct default_traits {
+#if defined(JTYPES_SPARSE_ARRAYS)
+            using array_type = sparse_vector<Value, node_allocator<Value> >;
+#else
+            using array_type = std::vector<Value, node_allocator<Value> >;
+#endif
+#if defined(JTYPES_HASH_OBJECTS)
+            using object_type = flat_map<Key, Value, key_hash, node_allocator<std::pair<Key, Value> > >;
+#else
+            using object_type = std::map<Key, Value, std::less<Key>, node_allocator<std::pair<const Key, Value> > >;
+#endif
+        };
+        
+#if defined(JTYPES_TRAITS)
+        using traits = JTYPES_TRAITS<jtype, object_key>;
+#else
+        using traits = default_traits<jtype, object_key>;
+#endif
+        
+        using array_vector = traits::array_type;
+        using object_map = traits::object_type;
+        
+        // Position of each stored alternative, matches the order of jtype::vtype.
+        template<typename T> struct type_tag;
+        template<> struct type_tag<undefined_t> { static const std::uint8_t value = 0; };
+        template<> struct type_tag<std::nullptr_t> { static const std::uint8_t value = 1; };
+        template<> struct type_tag<bool> { static const std::uint8_t value = 2; };
+        template<> struct type_tag<std::int64_t> { static const std::uint8_t value = 3; };
+        template<> struct type_tag<std::uint64_t> { static const std::uint8_t value = 4; };
+        template<> struct type_tag<double> { static const std::uint8_t value = 5; };
+        template<> struct type_tag<std::string> { static const std::uint8_t value = 6; };
+        template<> struct type_tag<fnc_holder> { static const std::uint8_t value = 7; };
+        template<> struct type_tag<array_vector> { static const std::uint8_t value = 8; };
+        template<> struct type_tag<object_map> { static const std::uint8_t value = 9; };
+        
+#if defined(JTYPES_COMPACT_STORAGE)
+        
+        /**
+            Reference counted payload of arrays and objects when JTYPES_COPY_ON_WRITE is defined.
+         
+            References into a payload are only handed out by its sole owner, an owner of a
+            shared payload detaches first. Handing out a reference pins the payload, copies
+            of a pinned payload copy its elements instead of sharing the payload. Nested
+            payloads that were not pinned stay shared, so copies remain one level deep.
+         
+            An owner that detaches through a const access cannot release the shared payload
+            right away, since concurrent readers of the same owner may still use it. The
+            payload is retained by the detached copy until the owner's next mutable access.
+        */
+        template<typename T>
+        struct cow_box {
+            // The highest bit of state marks a pinned payload, the others count owners.
+            static const std::size_t pinned = std::size_t(1) << (std::numeric_limits<std::size_t>::digits - 1);
+            
+            explicit cow_box(const T &v, std::size_t s = 1) : state(s), retained(nullptr), value(v) {}
+            explicit cow_box(T &&v) : state(1), retained(nullptr), value(std::move(v)) {}
+            ~cow_box() { release(retained); }
+            
+            static std::size_t owners(std::size_t s) { return s & ~pinned; }
+            
+            static void release(cow_box *box) noexcept {
+                if (box && owners(box->state.fetch_sub(1, std::memory_order_acq_rel)) == 1) {
+                    delete box;
+                }
+            }
+            
+            std::atomic<std::size_t> state;
+            cow_box *retained;
+            T value;
+        };
+        
+        /** 
+            Compact storage engine for jtype, enabled by defining JTYPES_COMPACT_STORAGE.
+         
+            Booleans and numbers are stored inline. Strings, functions, arrays and objects
+            are heap allocated and owned through a single pointer. Together with a one
+            byte type tag every jtype occupies 16 bytes.
+         
+            With JTYPES_COPY_ON_WRITE copies share array and object payloads. The first
+            access through get() detaches a shared payload from its other owners, peek()
+            reads a shared payload in place.
+         
+            Provides the subset of the variant interface used by jtype. which() returns
+            the type tag.
+        */
+        class compact_value {
+        public:
+            compact_value() noexcept;
+            compact_value(undefined_t) noexcept;
+            compact_value(std::nullptr_t) noexcept;
+            compact_value(bool v) noexcept;
+            compact_value(std::int64_t v) noexcept;
+            compact_value(std::uint64_t v) noexcept;
+            compact_value(double v) noexcept;
+            compact_value(const std::string &v);
+            compact_value(std::string &&v);
+            compact_value(const fnc_holder &v);
+            compact_value(fnc_holder &&v);
+            compact_value(const array_vector &v);
+            compact_value(array_vector &&v);
+            compact_value(const object_map &v);
+            compact_value(object_map &&v);
+            
+            compact_value(const compact_value &rhs);
+            compact_value(compact_value &&rhs) noexcept;
+            ~compact_value();
+            
+            compact_value &operator=(const compact_value &rhs);
+            compact_value &operator=(compact_value &&rhs) noexcept;
+            
+            template<typename T, typename = typename std::enable_if<!std::is_same<typename std::decay<T>::type, compact_value>::value>::type>
+            compact_value &operator=(T &&rhs) {
+                compact_value tmp(std::forward<T>(rhs));
+                swap(tmp);
+                return *this;
+            }
+            
+            void swap(compact_value &other) noexcept;
+            
+            int which() const { return _tag; }
+            
+            template<typename T>
+            bool is() const { return _tag == type_tag<T>::value; }
+            
+            template<typename T>
+            T &get();
+            
+            template<typename T>
+            const T &get() const;
+            
+            /** Read access for callers that do not keep references into arrays and objects. */
+            template<typename T>
+            const T &peek() const;
+            
+            bool operator==(const compact_value &rhs) const;
+            
+        private:
+            void destroy() noexcept;
+            
+            template<typename T>
+            T &heap() const { return *static_cast<T*>(_data.p); }
+            
+#if defined(JTYPES_COPY_ON_WRITE)
+            // Const accesses may detach concurrently, so shared payloads are read atomically.
+            std::atomic<void*> &shared_ptr() const {
+                static_assert(sizeof(std::atomic<void*>) == sizeof(void*), "atomic pointer must not add state");
+                return *reinterpret_cast<std::atomic<void*>*>(const_cast<void**>(&_data.p));
+            }
+            
+            template<typename T>
+            cow_box<T> *box() const { return static_cast<cow_box<T>*>(shared_ptr().load(std::memory_order_acquire)); }
+
+            template<typename T>
+            using is_shared = std::integral_constant<bool,
+                std::is_same<T, array_vector>::value || std::is_same<T, object_map>::value>;
+            
+            template<typename T> T &payload(std::false_type) { return heap<T>(); }
+            template<typename T> const T &payload(std::false_type) const { return heap<T>(); }
+            template<typename T> T &payload(std::true_type);
+            template<typename T> const T &payload(std::true_type) const;
+            
+            template<typename T> void share(const compact_value &rhs);
+            template<typename T> void release() noexcept;
+#else
+            template<typename T> T &payload(std::false_type) const { return heap<T>(); }
+            
+            template<typename T>
+            using is_shared = std::false_type;
+#endif
+            
+            union {
+                undefined_t un;
+                std::nullptr_t n;
+                bool b;
+                std::int64_t i;
+                std::uint64_t u;
+                double d;
+                void *p;
+            } _data;
+            
+            std::uint8_t _tag;
+        };
+        
+        template<typename T>
+        inline T &compact_value::get() {
+            if (!is<T>())
+                throw type_error("get() stored type does not match requested type");
+            return payload<T>(is_shared<T>());
+        }
+        
+        template<typename T>
+        inline const T &compact_value::get() const {
+            if (!is<T>())
+                throw type_error("get() stored type does not match requested type");
+            return payload<T>(is_shared<T>());
+        }
+        
+        template<typename T>
+        inline const T &compact_value::peek() const {
+#if defined(JTYPES_COPY_ON_WRITE)
+            if (is_shared<T>::value && is<T>())
+                return box<T>()->value;
+#endif
+            return get<T>();
+        }
+        
+        // Inline alternatives are returned unchecked, callers dispatch on which() first.
+        template<> inline undefined_t &compact_value::get<undefined_t>() { return _data.un; }
+        template<> inline const undefined_t &compact_value::get<undefined_t>() const { return _data.un; }
+        template<> inline std::nullptr_t &compact_value::get<std::nullptr_t>() { return _data.n; }
+        template<> inline const std::nullptr_t &compact_value::get<std::nullptr_t>() const { return _data.n; }
+        template<> inline bool &compact_value::get<bool>() { return _data.b; }
+        template<> inline const bool &compact_value::get<bool>() const { return _data.b; }
+        template<> inline std::int64_t &compact_value::get<std::int64_t>() { return _data.i; }
+        template<> inline const std::int64_t &compact_value::get<std::int64_t>() const { return _data.i; }
+        template<> inline std::uint64_t &compact_value::get<std::uint64_t>() { return _data.u; }
+        template<> inline const std::uint64_t &compact_value::get<std::uint64_t>() const { return _data.u; }
+        template<> inline double &compact_value::get<double>() { return _data.d; }
+        template<> inline const double &compact_value::get<double>() const { return _data.d; }
+        
+#endif
+    }
+
+    
+    class jtype {
+    public:
+        enum class vtype {
+            undefined = 0,
+            null,
+            boolean,
+            signed_number,
+            unsigned_number,
+            real_number,
+            string,
+            function,
+            array,
+            object,
+        };
+        
+        using undefined_t = details::undefined_t ;
+        using null_t = std::nullptr_t ;
+        using number_t = variant<std::int64_t, std::uint64_t, double>;
+        using function_t = details::fnc_holder;
+        using array_t = details::array_vector;
+        using object_t = details::object_map;
+
+        using iterator = details::var_iterator<jtype>;
+        using const_iterator = details::var_iterator<jtype const>;
+        using value_type = jtype;
+
+
+        using null = null_t;
+        using undefined = undefined_t;
+        using object = object_t;
+        using array = array_t;
+        
+        // Value initializers
+        
+        jtype();
+        
+        jtype(std::nullptr_t);
+        
+        jtype(bool v);
+        
+        template<typename I>
+        jtype(I t, typename meta::if_is_signed_integral<I>* unused = 0);
+        
+        template<typename I>
+        jtype(I t, typename meta::if_is_unsigned_integral<I>* unused = 0);
+        
+        template<typename I>
+        jtype(I t, typename meta::if_is_real<I>* unused = 0);
+        
+        jtype(char v);
+        
+        jtype(const char* v);
+        
+        jtype(const std::string &v);
+        
+        jtype(std::string &&v);
+
+        jtype(const undefined_t &v);
+        jtype(undefined_t &&v);
+        
+        // Copy and move initializers
+        
+        jtype(const jtype &rhs) = default;
+        jtype(jtype &&rhs) noexcept;
+
+        // Function initializers
+        template<class Sig, typename = meta::if_is_function<Sig> >
+        static jtype function(std::function<Sig> && v = std::function<Sig>());
+
+        jtype(const function_t &v);
+        jtype(function_t &&v);
+
+        // Array initializers
+        
+        jtype(const array_t &v);
+        jtype(array_t &&v);
+        
+        // Dictionary initializers
+
+        jtype(const object_t &v);
+        jtype(object_t &&v);
+
+        // Assignments
+
+        jtype &operator=(const jtype &rhs) = default;
+        jtype &operator=(jtype &&rhs) noexcept;
+        jtype &operator=(std::nullptr_t);
+        jtype &operator=(bool rhs);
+        jtype &operator=(char rhs);
+        jtype &operator=(const char* v);
+        jtype &operator=(const std::string &rhs);
+        jtype &operator=(std::string &&rhs);
+
+        template<typename I>
+        meta::if_is_signed_integral<I, jtype&>
+            operator=(I t);
 
         template<typename I>
         meta::if_is_unsigned_integral<I, jtype&>
@@ -301,112 +1550,1413 @@ namespace jtypes {
         jtype &operator=(const function_t &rhs);
         jtype &operator=(function_t &&rhs);
 
-        jtype &operator=(const undefined_t &rhs);
-        jtype &operator=(undefined_t &&rhs);
+        jtype &operator=(const undefined_t &rhs);
+        jtype &operator=(undefined_t &&rhs);
+        
+        // Type queries
+        vtype type() const;
+        bool is_undefined() const;
+        bool is_null() const;
+        bool is_boolean() const;
+        bool is_number() const;
+        bool is_signed_number() const;
+        bool is_unsigned_number() const;
+        bool is_real_number() const;
+        bool is_string() const;
+        bool is_function() const;
+        bool is_array() const;
+        bool is_object() const;
+        bool is_structured() const;
+        
+        // Getters with coercion
+        
+        template<class T>
+        explicit operator T() const;
+        explicit operator bool() const;
+        
+        template<typename T>
+        meta::if_not_is_function<T, T> as(const jtype &opts = undefined()) const;
+        
+        template<typename T>
+        meta::if_is_function<T, std::function<T> > as(const jtype &opts = undefined()) const;
+        
+        // Non-throwing getters. try_as() is empty where as() would throw, get_if()
+        // points to the stored value when it is exactly of type T.
+        
+        template<typename T>
+        optional<T> try_as() const;
+        
+        // As above, error tells why the conversion failed.
+        template<typename T>
+        optional<T> try_as(coerce_error &error) const;
+        
+        template<typename T>
+        T *get_if();
+        
+        template<typename T>
+        const T *get_if() const;
+        
+        // Visitation
+        
+        template<typename Visitor>
+        auto visit(Visitor &&v) -> decltype(v(std::declval<undefined_t&>()));
+        
+        template<typename Visitor>
+        auto visit(Visitor &&v) const -> decltype(v(std::declval<const undefined_t&>()));
+        
+        // Callable interface
+
+        template<typename Sig, typename ...Args>
+        typename meta::result_of_sig<Sig>::type
+        invoke(Args && ... args) const;
+        
+        // Array / Object accessors
+        
+        jtype &operator[](const jtype &key);
+        jtype &operator[](jtype &&key);
+        const jtype &operator[](const jtype &key) const;
+        
+        template<typename Atom>
+        meta::if_is_atom<Atom, jtype&> operator[](const Atom &key);
+        
+        template<typename Atom>
+        meta::if_is_atom<Atom, const jtype&> operator[](const Atom &key) const;
+        
+        // Property access by string without a temporary jtype key. Templates keep
+        // x[0] from converting to a string.
+        template<typename String>
+        meta::if_is_string<String, jtype&> operator[](String &&key);
+        
+        template<typename String>
+        meta::if_is_string<String, const jtype&> operator[](const String &key) const;
+        
+        template<std::size_t N>
+        jtype &operator[](const char (&key)[N]);
+        
+        template<std::size_t N>
+        const jtype &operator[](const char (&key)[N]) const;
+        
+        class property_accessor;
+        class path;
+        class pointer;
+        
+        // Non-throwing lookups, null when this is not structured or the key is not present.
+        
+        jtype *find(const jtype &key);
+        const jtype *find(const jtype &key) const;
+        
+        template<typename String>
+        meta::if_is_string<String, jtype*> find(const String &key);
+        
+        template<typename String>
+        meta::if_is_string<String, const jtype*> find(const String &key) const;
+        
+        template<std::size_t N>
+        jtype *find(const char (&key)[N]);
+        
+        template<std::size_t N>
+        const jtype *find(const char (&key)[N]) const;
+        
+        // This or default value.
+        
+        const jtype &operator|(const jtype &default_value) const;
+        
+        // Keys accessor
+        array_t keys() const;
+        array_t values() const;
+        
+        // Lazy views, iterate keys, values or key / value pairs without copying.
+        
+        using keys_range = details::range<details::projected_iterator<const_iterator, details::key_projection> >;
+        using values_range = details::range<iterator>;
+        using const_values_range = details::range<const_iterator>;
+        using items_range = details::range<details::projected_iterator<iterator, details::item_projection<jtype> > >;
+        using const_items_range = details::range<details::projected_iterator<const_iterator, details::item_projection<const jtype> > >;
+        
+        keys_range keys_view() const;
+        values_range values_view();
+        const_values_range values_view() const;
+        items_range items();
+        const_items_range items() const;
+        
+        // Container iterators, random access for arrays. Throw type_error on other types.
+        
+        using elements_range = details::range<array_t::iterator>;
+        using const_elements_range = details::range<array_t::const_iterator>;
+        using properties_range = details::range<object_t::iterator>;
+        using const_properties_range = details::range<object_t::const_iterator>;
+        
+        elements_range elements();
+        const_elements_range elements() const;
+        properties_range properties();
+        const_properties_range properties() const;
+        
+        // Iterator access
+        iterator begin();
+        iterator end();
+        
+        const_iterator begin() const;
+        const_iterator end() const;
+        
+        // Array inserters
+
+        void push_back(const jtype &v);
+        void push_back(jtype &&v);
+        
+        template<typename ...Args>
+        jtype &emplace_back(Args && ... args);
+        
+#if defined(JTYPES_COPY_ON_WRITE)
+        // Versioned updates, return a modified copy and leave this unchanged. The copy
+        // of the updated container takes O(n) in its number of elements, nested
+        // containers are shared. Available with JTYPES_COPY_ON_WRITE only, since
+        // without sharing every version would be a deep copy.
+        
+        jtype with(const jtype &key, jtype value) const;
+        jtype push(jtype value) const;
+#endif
+        
+        // Comparison interface
+        
+        bool operator==(jtype const& rhs) const;
+        bool operator!=(jtype const& rhs) const;
+        bool operator<(jtype const& rhs) const;
+        bool operator>(jtype const& rhs) const;
+        bool operator<=(jtype const& rhs) const;
+        bool operator>=(jtype const &rhs) const;
+        
+        
+        jtype size() const;
+        
+        // Helper methods
+        
+        jtype &merge_from(const jtype &other);
+        
+        jtype split(const jtype &separator) const;
+        
+        jtype &at(const jtype &path);
+        const jtype &at(const jtype &path) const;
+        
+        jtype &at(const path &p);
+        const jtype &at(const path &p) const;
+        
+        jtype &at(const pointer &p);
+        const jtype &at(const pointer &p) const;
+        
+        void clear();
+
+        const jtype& global_undefined() const;
+        
+    private:
+        template<typename Predicate>
+        bool compare(const Predicate &pred, const jtype &rhs) const;
+        
+#if defined(JTYPES_COMPACT_STORAGE)
+        typedef details::compact_value oneof;
+#else
+        typedef variant<
+        undefined_t,
+        null_t,
+        bool,
+        std::int64_t,
+        std::uint64_t,
+        double,
+        std::string,
+        function_t,
+        array_t,
+        object_t
+        > oneof;
+#endif
+        
+        oneof _value;
+    };
+
+    inline bool operator<(const jtype::object_t &lhs, const jtype::object_t &rhs) { return false; }
+    
+    namespace details {
         
-        // Type queries
-        vtype type() const;
-        bool is_undefined() const;
-        bool is_null() const;
-        bool is_boolean() const;
-        bool is_number() const;
-        bool is_signed_number() const;
-        bool is_unsigned_number() const;
-        bool is_real_number() const;
-        bool is_string() const;
-        bool is_function() const;
-        bool is_array() const;
-        bool is_object() const;
-        bool is_structured() const;
+        // Single dispatch over all stored alternatives, works for both storage engines.
+        template<typename F, typename V>
+        inline auto visit_value(F &&f, V &v) -> decltype(f(v.template get<undefined_t>())) {
+            switch (v.which()) {
+                case type_tag<undefined_t>::value: return f(v.template get<undefined_t>());
+                case type_tag<std::nullptr_t>::value: return f(v.template get<std::nullptr_t>());
+                case type_tag<bool>::value: return f(v.template get<bool>());
+                case type_tag<std::int64_t>::value: return f(v.template get<std::int64_t>());
+                case type_tag<std::uint64_t>::value: return f(v.template get<std::uint64_t>());
+                case type_tag<double>::value: return f(v.template get<double>());
+                case type_tag<std::string>::value: return f(v.template get<std::string>());
+                case type_tag<fnc_holder>::value: return f(v.template get<fnc_holder>());
+                case type_tag<jtype::array_t>::value: return f(v.template get<jtype::array_t>());
+                default: return f(v.template get<jtype::object_t>());
+            }
+        }
         
-        // Getters with coercion
+        // Read access that neither detaches nor pins copy-on-write payloads, see compact_value::peek().
+        template<typename T, typename V>
+        inline const T &peek_value(const V &v) {
+            return v.template get<T>();
+        }
         
-        template<class T>
-        explicit operator T() const;
-        explicit operator bool() const;
+#if defined(JTYPES_COMPACT_STORAGE)
+        template<typename T>
+        inline const T &peek_value(const compact_value &v) {
+            return v.template peek<T>();
+        }
+#endif
+        
+        // Keys used to search object_t without creating new keys.
+#if defined(JTYPES_INTERN_KEYS)
+        inline atom lookup_key(const std::string &k) { return atom::unowned(k); }
+        inline const atom &lookup_key(const atom &k) { return k; }
+#else
+        inline const std::string &lookup_key(const std::string &k) { return k; }
+        inline const std::string &lookup_key(const atom &k) { return k.str(); }
+#endif
+        
+        // Reused per thread for lookups by string literal, so that long keys do not allocate.
+        inline std::string &key_buffer() {
+            static thread_local std::string buffer;
+            return buffer;
+        }
+        
+        inline const std::string &key_string(const std::string &k) { return k; }
+        inline const std::string &key_string(const atom &k) { return k.str(); }
+        
+        template<typename Key>
+        inline jtype &find_or_insert(ordered_map &o, Key &&k) {
+            auto iter = o.lower_bound(lookup_key(k));
+            if (iter == o.end() || o.key_comp()(lookup_key(k), iter->first)) {
+                iter = o.emplace_hint(iter, std::forward<Key>(k), jtype());
+            }
+            return iter->second;
+        }
+        
+        template<typename Map, typename Key>
+        inline jtype &find_or_insert(Map &o, Key &&k) {
+            auto iter = o.find(lookup_key(k));
+            if (iter == o.end()) {
+                iter = o.emplace(std::forward<Key>(k), jtype()).first;
+            }
+            return iter->second;
+        }
+        
+        // Lookups through a position hint. Only hash_map has stable positions, other maps ignore it.
+        inline hash_map::iterator find_hinted(hash_map &o, const object_key &k, std::size_t &hint) {
+            return o.find(k, hint);
+        }
+        
+        inline hash_map::const_iterator find_hinted(const hash_map &o, const object_key &k, std::size_t &hint) {
+            return o.find(k, hint);
+        }
+        
+        template<typename Map>
+        inline auto find_hinted(Map &o, const object_key &k, std::size_t &) -> decltype(o.find(k)) {
+            return o.find(k);
+        }
+    }
+    
+    /**
+        Inline cache for reading the same property from many objects.
+     
+        The accessor prepares the property name once and remembers the position at
+        which it was found last. Objects created with the same sequence of properties
+        keep that property at the same position, so repeated access compares a single
+        key instead of searching. A miss falls back to a regular lookup. Positions are
+        stable only for the hash object backend (JTYPES_HASH_OBJECTS), with std::map
+        every access is a regular lookup.
+     
+        The remembered position is updated atomically, so a const accessor, path or
+        pointer can be shared between threads that read concurrently.
+    */
+    class jtype::property_accessor {
+    public:
+        explicit property_accessor(const details::object_key &key)
+        : _key(key), _hint(0) {
+        }
+        
+        property_accessor(const property_accessor &rhs)
+        : _name(rhs._name), _key(rhs._key), _hint(rhs._hint.load(std::memory_order_relaxed)) {
+        }
+        
+        property_accessor &operator=(const property_accessor &rhs) {
+            _name = rhs._name;
+            _key = rhs._key;
+            _hint.store(rhs._hint.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            return *this;
+        }
+        
+        const details::object_key &key() const { return _key; }
+        
+        jtype &operator()(jtype &obj) const {
+            if (!obj.is_object()) {
+                throw type_error("property_accessor requires object type");
+            }
+            
+            object_t &o = obj._value.get<object_t>();
+            auto iter = find(o);
+            if (iter != o.end()) {
+                return iter->second;
+            }
+            return _name ? details::find_or_insert(o, details::object_key(*_name)) : details::find_or_insert(o, _key);
+        }
+        
+        const jtype &operator()(const jtype &obj) const {
+            if (!obj.is_object()) {
+                throw type_error("property_accessor requires object type");
+            }
+            
+            const object_t &o = obj._value.get<object_t>();
+            auto iter = find(o);
+            return iter != o.end() ? iter->second : obj.global_undefined();
+        }
+        
+    private:
+        friend class jtype::path;
+        friend class jtype::pointer;
+        
+        // Refers to a name owned by the accessor without interning it. The name is
+        // interned only when a missing property is created.
+        explicit property_accessor(std::shared_ptr<const std::string> name)
+        : _name(std::move(name)), _key(details::lookup_key(*_name)), _hint(0) {
+        }
+        
+        template<typename Map>
+        auto find(Map &o) const -> decltype(o.end()) {
+            std::size_t hint = _hint.load(std::memory_order_relaxed);
+            const std::size_t last = hint;
+            auto iter = details::find_hinted(o, _key, hint);
+            if (hint != last) {
+                _hint.store(hint, std::memory_order_relaxed);
+            }
+            return iter;
+        }
+        
+        std::shared_ptr<const std::string> _name;
+        details::object_key _key;
+        mutable std::atomic<std::size_t> _hint;
+    };
+    
+    /**
+        Pre-split property path for at().
+     
+        A path is compiled once from a dotted string, a jtype array of property names or
+        a list of property names, the latter allowing names that contain dots. Each
+        segment is a property_accessor, so resolving a path allocates nothing for lookups
+        and remembers where each property was found last.
+    */
+    class jtype::path {
+    public:
+        path() {}
+        
+        explicit path(const std::string &dotted) {
+            split(dotted);
+        }
+        
+        explicit path(const char *dotted)
+        : path(std::string(dotted)) {
+        }
+        
+        // Array elements are property names, anything else is a dotted path.
+        explicit path(const jtype &p) {
+            assign(p);
+        }
+        
+        path(std::initializer_list<std::string> segments) {
+            for (auto && s : segments) {
+                add(s);
+            }
+        }
+        
+        std::size_t size() const { return _segments.size(); }
+        bool empty() const { return _segments.empty(); }
+        
+    private:
+        friend class jtype;
+        
+        struct lookup_only {};
+        
+        // Segments do not intern their names, for paths that are resolved once.
+        path(const jtype &p, lookup_only)
+        : _lookup_only(true) {
+            assign(p);
+        }
+        
+        void assign(const jtype &p);
+        
+        void split(const std::string &dotted) {
+            std::size_t begin = 0;
+            while (begin <= dotted.size()) {
+                std::size_t end = dotted.find('.', begin);
+                if (end == std::string::npos) end = dotted.size();
+                if (end > begin) add(dotted.substr(begin, end - begin));
+                begin = end + 1;
+            }
+        }
+        
+        void add(const std::string &name) {
+            if (_lookup_only) {
+                _segments.push_back(property_accessor(std::make_shared<const std::string>(name)));
+            } else {
+                _segments.push_back(property_accessor(details::object_key(name)));
+            }
+        }
+        
+        std::vector<property_accessor> _segments;
+        bool _lookup_only = false;
+    };
+    
+    /**
+        Pre-parsed JSON Pointer according to RFC 6901, e.g. "/a/b~1c/0".
+     
+        Reference tokens are unescaped once and array indices are parsed once, so
+        resolving a pointer allocates nothing for lookups. Tokens are not interned,
+        a property name is interned only when a missing property is created. In non-const context missing
+        properties and array elements are created like at() does, a "-" token appends
+        to an array. In const context a missing value resolves to undefined.
+    */
+    class jtype::pointer {
+    public:
+        pointer() {}
+        
+        explicit pointer(const std::string &p) {
+            if (!p.empty() && p[0] != '/') {
+                throw syntax_error("pointer must be empty or start with '/'");
+            }
+            
+            std::size_t begin = 1;
+            while (begin <= p.size()) {
+                std::size_t end = p.find('/', begin);
+                if (end == std::string::npos) end = p.size();
+                add(unescape(p, begin, end));
+                begin = end + 1;
+            }
+        }
+        
+        explicit pointer(const char *p)
+        : pointer(std::string(p)) {
+        }
+        
+        std::size_t size() const { return _tokens.size(); }
+        bool empty() const { return _tokens.empty(); }
+        
+        // Escaped string representation.
+        std::string to_string() const {
+            std::string s;
+            for (auto && t : _tokens) {
+                s.push_back('/');
+                for (char c : details::key_string(t.key.key())) {
+                    if (c == '~') s += "~0";
+                    else if (c == '/') s += "~1";
+                    else s.push_back(c);
+                }
+            }
+            return s;
+        }
+        
+    private:
+        friend class jtype;
+        
+        static const std::size_t no_index = std::size_t(-1);
+        static const std::size_t append_index = std::size_t(-2);
+        
+        struct token {
+            property_accessor key;
+            std::size_t index;
+        };
+        
+        static std::string unescape(const std::string &p, std::size_t begin, std::size_t end) {
+            std::string t;
+            for (std::size_t i = begin; i < end; ++i) {
+                if (p[i] != '~') {
+                    t.push_back(p[i]);
+                } else if (i + 1 < end && (p[i + 1] == '0' || p[i + 1] == '1')) {
+                    t.push_back(p[++i] == '0' ? '~' : '/');
+                } else {
+                    throw syntax_error("pointer contains invalid escape sequence");
+                }
+            }
+            return t;
+        }
+        
+        static std::size_t parse_index(const std::string &t) {
+            if (t == "-") return append_index;
+            if (t.empty() || (t[0] == '0' && t.size() > 1)) return no_index;
+            
+            std::size_t idx = 0;
+            for (char c : t) {
+                if (c < '0' || c > '9' || idx > (no_index - 3 - std::size_t(c - '0')) / 10) return no_index;
+                idx = idx * 10 + std::size_t(c - '0');
+            }
+            return idx;
+        }
+        
+        void add(const std::string &t) {
+            _tokens.push_back(token{property_accessor(std::make_shared<const std::string>(t)), parse_index(t)});
+        }
+        
+        std::vector<token> _tokens;
+    };
+    
+#if defined(JTYPES_COMPACT_STORAGE)
+    
+    // Implementation of compact_value
+    
+    namespace details {
+        
+        inline compact_value::compact_value() noexcept
+        : _tag(type_tag<undefined_t>::value) {
+            _data.p = nullptr;
+        }
+        
+        inline compact_value::compact_value(undefined_t) noexcept
+        : compact_value() {
+        }
+        
+        inline compact_value::compact_value(std::nullptr_t) noexcept
+        : _tag(type_tag<std::nullptr_t>::value) {
+            _data.p = nullptr;
+        }
+        
+        inline compact_value::compact_value(bool v) noexcept
+        : _tag(type_tag<bool>::value) {
+            _data.p = nullptr;
+            _data.b = v;
+        }
+        
+        inline compact_value::compact_value(std::int64_t v) noexcept
+        : _tag(type_tag<std::int64_t>::value) {
+            _data.i = v;
+        }
+        
+        inline compact_value::compact_value(std::uint64_t v) noexcept
+        : _tag(type_tag<std::uint64_t>::value) {
+            _data.u = v;
+        }
+        
+        inline compact_value::compact_value(double v) noexcept
+        : _tag(type_tag<double>::value) {
+            _data.d = v;
+        }
+        
+        inline compact_value::compact_value(const std::string &v)
+        : _tag(type_tag<std::string>::value) {
+            _data.p = new std::string(v);
+        }
+        
+        inline compact_value::compact_value(std::string &&v)
+        : _tag(type_tag<std::string>::value) {
+            _data.p = new std::string(std::move(v));
+        }
+        
+        inline compact_value::compact_value(const fnc_holder &v)
+        : _tag(type_tag<fnc_holder>::value) {
+            _data.p = new fnc_holder(v);
+        }
+        
+        inline compact_value::compact_value(fnc_holder &&v)
+        : _tag(type_tag<fnc_holder>::value) {
+            _data.p = new fnc_holder(std::move(v));
+        }
+        
+#if defined(JTYPES_COPY_ON_WRITE)
+        inline compact_value::compact_value(const jtype::array_t &v)
+        : _tag(type_tag<jtype::array_t>::value) {
+            _data.p = new cow_box<jtype::array_t>(v);
+        }
+        
+        inline compact_value::compact_value(jtype::array_t &&v)
+        : _tag(type_tag<jtype::array_t>::value) {
+            _data.p = new cow_box<jtype::array_t>(std::move(v));
+        }
+        
+        inline compact_value::compact_value(const jtype::object_t &v)
+        : _tag(type_tag<jtype::object_t>::value) {
+            _data.p = new cow_box<jtype::object_t>(v);
+        }
+        
+        inline compact_value::compact_value(jtype::object_t &&v)
+        : _tag(type_tag<jtype::object_t>::value) {
+            _data.p = new cow_box<jtype::object_t>(std::move(v));
+        }
+        
+        inline compact_value::compact_value(const compact_value &rhs)
+        : _tag(rhs._tag) {
+            switch (_tag) {
+                case type_tag<std::string>::value: _data.p = new std::string(rhs.heap<std::string>()); break;
+                case type_tag<fnc_holder>::value: _data.p = new fnc_holder(rhs.heap<fnc_holder>()); break;
+                case type_tag<jtype::array_t>::value: share<jtype::array_t>(rhs); break;
+                case type_tag<jtype::object_t>::value: share<jtype::object_t>(rhs); break;
+                default: _data = rhs._data; break;
+            }
+        }
         
         template<typename T>
-        meta::if_not_is_function<T, T> as(const jtype &opts = undefined()) const;
+        inline void compact_value::share(const compact_value &rhs) {
+            // Payloads are only shared when a copy would use the same allocator, which
+            // keeps copies independent of the arena the source was allocated from.
+            cow_box<T> *box = rhs.box<T>();
+            std::size_t s = box->state.load(std::memory_order_relaxed);
+            while (!(s & cow_box<T>::pinned) && box->value.get_allocator() == typename T::allocator_type()) {
+                if (box->state.compare_exchange_weak(s, s + 1, std::memory_order_relaxed)) {
+                    _data.p = box;
+                    return;
+                }
+            }
+            _data.p = new cow_box<T>(box->value);
+        }
         
         template<typename T>
-        meta::if_is_function<T, std::function<T> > as(const jtype &opts = undefined()) const;
+        inline void compact_value::release() noexcept {
+            cow_box<T>::release(box<T>());
+        }
         
-        // Callable interface
+        template<typename T>
+        inline T &compact_value::payload(std::true_type) {
+            cow_box<T> *box = this->box<T>();
+            if (cow_box<T>::owners(box->state.load(std::memory_order_acquire)) != 1) {
+                cow_box<T> *own = new cow_box<T>(box->value, 1 | cow_box<T>::pinned);
+                release<T>();
+                _data.p = own;
+                return own->value;
+            }
+            
+            // Mutable access is exclusive, no reader of this owner still uses a retained payload.
+            box->state.fetch_or(cow_box<T>::pinned, std::memory_order_relaxed);
+            cow_box<T>::release(box->retained);
+            box->retained = nullptr;
+            return box->value;
+        }
+        
+        template<typename T>
+        inline const T &compact_value::payload(std::true_type) const {
+            cow_box<T> *box = this->box<T>();
+            std::size_t s = box->state.load(std::memory_order_acquire);
+            while (cow_box<T>::owners(s) == 1) {
+                if ((s & cow_box<T>::pinned) || box->state.compare_exchange_weak(s, s | cow_box<T>::pinned, std::memory_order_acq_rel)) {
+                    return box->value;
+                }
+            }
+            
+            // Detach from the shared payload. Concurrent readers of this owner race to
+            // install their copy, the losers use the winning copy instead.
+            cow_box<T> *own = new cow_box<T>(box->value, 1 | cow_box<T>::pinned);
+            own->retained = box;
+            void *expected = box;
+            if (!shared_ptr().compare_exchange_strong(expected, own, std::memory_order_acq_rel)) {
+                own->retained = nullptr;
+                delete own;
+                return static_cast<cow_box<T>*>(expected)->value;
+            }
+            return own->value;
+        }
+#else
+        inline compact_value::compact_value(const jtype::array_t &v)
+        : _tag(type_tag<jtype::array_t>::value) {
+            _data.p = new jtype::array_t(v);
+        }
+        
+        inline compact_value::compact_value(jtype::array_t &&v)
+        : _tag(type_tag<jtype::array_t>::value) {
+            _data.p = new jtype::array_t(std::move(v));
+        }
+        
+        inline compact_value::compact_value(const jtype::object_t &v)
+        : _tag(type_tag<jtype::object_t>::value) {
+            _data.p = new jtype::object_t(v);
+        }
+        
+        inline compact_value::compact_value(jtype::object_t &&v)
+        : _tag(type_tag<jtype::object_t>::value) {
+            _data.p = new jtype::object_t(std::move(v));
+        }
+        
+        inline compact_value::compact_value(const compact_value &rhs)
+        : _data(rhs._data), _tag(rhs._tag) {
+            switch (_tag) {
+                case type_tag<std::string>::value: _data.p = new std::string(rhs.heap<std::string>()); break;
+                case type_tag<fnc_holder>::value: _data.p = new fnc_holder(rhs.heap<fnc_holder>()); break;
+                case type_tag<jtype::array_t>::value: _data.p = new jtype::array_t(rhs.heap<jtype::array_t>()); break;
+                case type_tag<jtype::object_t>::value: _data.p = new jtype::object_t(rhs.heap<jtype::object_t>()); break;
+                default: break;
+            }
+        }
+#endif
+        
+        inline compact_value::compact_value(compact_value &&rhs) noexcept
+        : _data(rhs._data), _tag(rhs._tag) {
+            rhs._tag = type_tag<undefined_t>::value;
+            rhs._data.p = nullptr;
+        }
+        
+        inline compact_value::~compact_value() {
+            destroy();
+        }
+        
+        inline compact_value &compact_value::operator=(const compact_value &rhs) {
+            compact_value tmp(rhs);
+            swap(tmp);
+            return *this;
+        }
+        
+        inline compact_value &compact_value::operator=(compact_value &&rhs) noexcept {
+            compact_value tmp(std::move(rhs));
+            swap(tmp);
+            return *this;
+        }
+        
+        inline void compact_value::swap(compact_value &other) noexcept {
+            std::swap(_data, other._data);
+            std::swap(_tag, other._tag);
+        }
+        
+        inline void compact_value::destroy() noexcept {
+            switch (_tag) {
+                case type_tag<std::string>::value: delete &heap<std::string>(); break;
+                case type_tag<fnc_holder>::value: delete &heap<fnc_holder>(); break;
+#if defined(JTYPES_COPY_ON_WRITE)
+                case type_tag<jtype::array_t>::value: release<jtype::array_t>(); break;
+                case type_tag<jtype::object_t>::value: release<jtype::object_t>(); break;
+#else
+                case type_tag<jtype::array_t>::value: delete &heap<jtype::array_t>(); break;
+                case type_tag<jtype::object_t>::value: delete &heap<jtype::object_t>(); break;
+#endif
+                default: break;
+            }
+            _tag = type_tag<undefined_t>::value;
+        }
+        
+        inline bool compact_value::operator==(const compact_value &rhs) const {
+            if (_tag != rhs._tag)
+                return false;
+            
+            switch (_tag) {
+                case type_tag<undefined_t>::value:
+                case type_tag<std::nullptr_t>::value: return true;
+                case type_tag<bool>::value: return _data.b == rhs._data.b;
+                case type_tag<std::int64_t>::value: return _data.i == rhs._data.i;
+                case type_tag<std::uint64_t>::value: return _data.u == rhs._data.u;
+                case type_tag<double>::value: return _data.d == rhs._data.d;
+                case type_tag<std::string>::value: return heap<std::string>() == rhs.heap<std::string>();
+                case type_tag<fnc_holder>::value: return heap<fnc_holder>() == rhs.heap<fnc_holder>();
+                case type_tag<jtype::array_t>::value: return peek<jtype::array_t>() == rhs.peek<jtype::array_t>();
+                default: return peek<jtype::object_t>() == rhs.peek<jtype::object_t>();
+            }
+        }
+    }
+    
+#endif
 
-        template<typename Sig, typename ...Args>
-        typename meta::result_of_sig<Sig>::type
-        invoke(Args && ... args) const;
+    
+    namespace details {
         
-        // Array / Object accessors
+        // Size of a buffer that holds any number written by format_number().
+        const std::size_t number_buffer_size = 32;
         
-        jtype &operator[](const jtype &key);
-        const jtype &operator[](const jtype &key) const;
+        // Writes the decimal digits of v to buf, returns the end of the written characters.
+        inline char *format_number(std::uint64_t v, char *buf) {
+            static const char pairs[] =
+                "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+                "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+                "8081828384858687888990919293949596979899";
+            
+            char tmp[20];
+            char *p = tmp + sizeof(tmp);
+            while (v >= 100) {
+                const std::size_t i = std::size_t(v % 100) * 2;
+                v /= 100;
+                *--p = pairs[i + 1];
+                *--p = pairs[i];
+            }
+            if (v >= 10) {
+                const std::size_t i = std::size_t(v) * 2;
+                *--p = pairs[i + 1];
+                *--p = pairs[i];
+            } else {
+                *--p = char('0' + v);
+            }
+            return std::copy(p, tmp + sizeof(tmp), buf);
+        }
+        
+        inline char *format_number(std::int64_t v, char *buf) {
+            if (v < 0) {
+                *buf++ = '-';
+                return format_number(std::uint64_t(0) - std::uint64_t(v), buf);
+            }
+            return format_number(std::uint64_t(v), buf);
+        }
+        
+        // Floating point number f * 2^e with a 64 bit significand, as used by Grisu.
+        struct diy_fp {
+            std::uint64_t f;
+            int e;
+            
+            diy_fp operator-(const diy_fp &rhs) const { return diy_fp{f - rhs.f, e}; }
+            
+            // Upper 64 bits of the 128 bit product, rounded.
+            diy_fp operator*(const diy_fp &rhs) const {
+                const std::uint64_t m32 = 0xFFFFFFFFu;
+                const std::uint64_t a = f >> 32, b = f & m32, c = rhs.f >> 32, d = rhs.f & m32;
+                const std::uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+                const std::uint64_t mid = (bd >> 32) + (ad & m32) + (bc & m32) + (std::uint64_t(1) << 31);
+                return diy_fp{ac + (ad >> 32) + (bc >> 32) + (mid >> 32), e + rhs.e + 64};
+            }
+            
+            diy_fp normalized() const {
+                diy_fp r = *this;
+                while (!(r.f & (std::uint64_t(1) << 63))) {
+                    r.f <<= 1;
+                    --r.e;
+                }
+                return r;
+            }
+        };
         
-        // This or default value.
+        struct cached_power {
+            std::uint64_t f;
+            int e;
+            int k;
+        };
         
-        const jtype &operator|(const jtype &default_value) const;
+        // Returns the cached 10^k that scales a normalized diy_fp with exponent e into [2^-60, 2^-32).
+        inline cached_power cached_power_for(int e) {
+            static const cached_power powers[] = {
+                {0xfa8fd5a0081c0288ull, -1220, -348}, {0xbaaee17fa23ebf76ull, -1193, -340},
+                {0x8b16fb203055ac76ull, -1166, -332}, {0xcf42894a5dce35eaull, -1140, -324},
+                {0x9a6bb0aa55653b2dull, -1113, -316}, {0xe61acf033d1a45dfull, -1087, -308},
+                {0xab70fe17c79ac6caull, -1060, -300}, {0xff77b1fcbebcdc4full, -1034, -292},
+                {0xbe5691ef416bd60cull, -1007, -284}, {0x8dd01fad907ffc3cull, -980, -276},
+                {0xd3515c2831559a83ull, -954, -268}, {0x9d71ac8fada6c9b5ull, -927, -260},
+                {0xea9c227723ee8bcbull, -901, -252}, {0xaecc49914078536dull, -874, -244},
+                {0x823c12795db6ce57ull, -847, -236}, {0xc21094364dfb5637ull, -821, -228},
+                {0x9096ea6f3848984full, -794, -220}, {0xd77485cb25823ac7ull, -768, -212},
+                {0xa086cfcd97bf97f4ull, -741, -204}, {0xef340a98172aace5ull, -715, -196},
+                {0xb23867fb2a35b28eull, -688, -188}, {0x84c8d4dfd2c63f3bull, -661, -180},
+                {0xc5dd44271ad3cdbaull, -635, -172}, {0x936b9fcebb25c996ull, -608, -164},
+                {0xdbac6c247d62a584ull, -582, -156}, {0xa3ab66580d5fdaf6ull, -555, -148},
+                {0xf3e2f893dec3f126ull, -529, -140}, {0xb5b5ada8aaff80b8ull, -502, -132},
+                {0x87625f056c7c4a8bull, -475, -124}, {0xc9bcff6034c13053ull, -449, -116},
+                {0x964e858c91ba2655ull, -422, -108}, {0xdff9772470297ebdull, -396, -100},
+                {0xa6dfbd9fb8e5b88full, -369, -92}, {0xf8a95fcf88747d94ull, -343, -84},
+                {0xb94470938fa89bcfull, -316, -76}, {0x8a08f0f8bf0f156bull, -289, -68},
+                {0xcdb02555653131b6ull, -263, -60}, {0x993fe2c6d07b7facull, -236, -52},
+                {0xe45c10c42a2b3b06ull, -210, -44}, {0xaa242499697392d3ull, -183, -36},
+                {0xfd87b5f28300ca0eull, -157, -28}, {0xbce5086492111aebull, -130, -20},
+                {0x8cbccc096f5088ccull, -103, -12}, {0xd1b71758e219652cull, -77, -4},
+                {0x9c40000000000000ull, -50, 4}, {0xe8d4a51000000000ull, -24, 12},
+                {0xad78ebc5ac620000ull, 3, 20}, {0x813f3978f8940984ull, 30, 28},
+                {0xc097ce7bc90715b3ull, 56, 36}, {0x8f7e32ce7bea5c70ull, 83, 44},
+                {0xd5d238a4abe98068ull, 109, 52}, {0x9f4f2726179a2245ull, 136, 60},
+                {0xed63a231d4c4fb27ull, 162, 68}, {0xb0de65388cc8ada8ull, 189, 76},
+                {0x83c7088e1aab65dbull, 216, 84}, {0xc45d1df942711d9aull, 242, 92},
+                {0x924d692ca61be758ull, 269, 100}, {0xda01ee641a708deaull, 295, 108},
+                {0xa26da3999aef774aull, 322, 116}, {0xf209787bb47d6b85ull, 348, 124},
+                {0xb454e4a179dd1877ull, 375, 132}, {0x865b86925b9bc5c2ull, 402, 140},
+                {0xc83553c5c8965d3dull, 428, 148}, {0x952ab45cfa97a0b3ull, 455, 156},
+                {0xde469fbd99a05fe3ull, 481, 164}, {0xa59bc234db398c25ull, 508, 172},
+                {0xf6c69a72a3989f5cull, 534, 180}, {0xb7dcbf5354e9beceull, 561, 188},
+                {0x88fcf317f22241e2ull, 588, 196}, {0xcc20ce9bd35c78a5ull, 614, 204},
+                {0x98165af37b2153dfull, 641, 212}, {0xe2a0b5dc971f303aull, 667, 220},
+                {0xa8d9d1535ce3b396ull, 694, 228}, {0xfb9b7cd9a4a7443cull, 720, 236},
+                {0xbb764c4ca7a44410ull, 747, 244}, {0x8bab8eefb6409c1aull, 774, 252},
+                {0xd01fef10a657842cull, 800, 260}, {0x9b10a4e5e9913129ull, 827, 268},
+                {0xe7109bfba19c0c9dull, 853, 276}, {0xac2820d9623bf429ull, 880, 284},
+                {0x80444b5e7aa7cf85ull, 907, 292}, {0xbf21e44003acdd2dull, 933, 300},
+                {0x8e679c2f5e44ff8full, 960, 308}, {0xd433179d9c8cb841ull, 986, 316},
+                {0x9e19db92b4e31ba9ull, 1013, 324}, {0xeb96bf6ebadf77d9ull, 1039, 332},
+                {0xaf87023b9bf0ee6bull, 1066, 340},
+            };
+            
+            const int k = int(std::ceil((-60 - (e + 64) + 63) * 0.30102999566398114));
+            return powers[(348 + k - 1) / 8 + 1];
+        }
         
-        // Keys accessor
-        array_t keys() const;
-        array_t values() const;
+        // Moves the last generated digit towards w while the result stays inside the
+        // boundaries. Fails when the imprecision of the scaled values leaves more than
+        // one candidate.
+        inline bool grisu_round_weed(char *digits, int length, std::uint64_t distance_too_high_w, std::uint64_t unsafe_interval,
+                                     std::uint64_t rest, std::uint64_t ten_kappa, std::uint64_t unit) {
+            const std::uint64_t small_distance = distance_too_high_w - unit;
+            const std::uint64_t big_distance = distance_too_high_w + unit;
+            
+            while (rest < small_distance && unsafe_interval - rest >= ten_kappa &&
+                   (rest + ten_kappa < small_distance || small_distance - rest >= rest + ten_kappa - small_distance)) {
+                --digits[length - 1];
+                rest += ten_kappa;
+            }
+            
+            if (rest < big_distance && unsafe_interval - rest >= ten_kappa &&
+                (rest + ten_kappa < big_distance || big_distance - rest > rest + ten_kappa - big_distance)) {
+                return false;
+            }
+            
+            return 2 * unit <= rest && rest <= unsafe_interval - 4 * unit;
+        }
         
-        // Iterator access
-        iterator begin();
-        iterator end();
+        /**
+            Shortest digits of v > 0 by Grisu3, such that v = digits * 10^exponent.
+         
+            Returns false for the rare values (about 0.5%) for which the shortest
+            representation cannot be proven with 64 bit arithmetic.
+        */
+        inline bool grisu3(double v, char *digits, int &length, int &exponent) {
+            std::uint64_t bits;
+            std::memcpy(&bits, &v, sizeof(v));
+            
+            const std::uint64_t hidden = std::uint64_t(1) << 52;
+            const std::uint64_t fraction = bits & (hidden - 1);
+            const int biased = int(bits >> 52) & 0x7FF;
+            const diy_fp d = biased == 0 ? diy_fp{fraction, -1074} : diy_fp{fraction + hidden, biased - 1075};
+            
+            // Boundaries halfway to the neighbouring doubles, the lower one is closer at powers of two.
+            const diy_fp plus = diy_fp{(d.f << 1) + 1, d.e - 1}.normalized();
+            diy_fp minus = (fraction == 0 && biased > 1) ? diy_fp{(d.f << 2) - 1, d.e - 2} : diy_fp{(d.f << 1) - 1, d.e - 1};
+            minus.f <<= minus.e - plus.e;
+            minus.e = plus.e;
+            
+            const diy_fp w = d.normalized();
+            const cached_power c = cached_power_for(w.e);
+            const diy_fp ten_mk = {c.f, c.e};
+            
+            const diy_fp scaled_w = w * ten_mk;
+            const diy_fp low = minus * ten_mk;
+            const diy_fp high = plus * ten_mk;
+            
+            // Generate digits of the upper boundary until they fall into the unsafe interval.
+            std::uint64_t unit = 1;
+            const diy_fp too_low = {low.f - unit, low.e};
+            const diy_fp too_high = {high.f + unit, high.e};
+            std::uint64_t unsafe_interval = (too_high - too_low).f;
+            
+            const int shift = -scaled_w.e;
+            const std::uint64_t one = std::uint64_t(1) << shift;
+            std::uint32_t integrals = std::uint32_t(too_high.f >> shift);
+            std::uint64_t fractionals = too_high.f & (one - 1);
+            
+            static const std::uint32_t pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+            int kappa = 10;
+            while (kappa > 0 && integrals < pow10[kappa - 1]) {
+                --kappa;
+            }
+            std::uint32_t divisor = kappa > 0 ? pow10[kappa - 1] : 0;
+            
+            length = 0;
+            while (kappa > 0) {
+                digits[length++] = char('0' + integrals / divisor);
+                integrals %= divisor;
+                --kappa;
+                
+                const std::uint64_t rest = (std::uint64_t(integrals) << shift) + fractionals;
+                if (rest < unsafe_interval) {
+                    exponent = kappa - c.k;
+                    return grisu_round_weed(digits, length, (too_high - scaled_w).f, unsafe_interval, rest, std::uint64_t(divisor) << shift, unit);
+                }
+                divisor /= 10;
+            }
+            
+            for (;;) {
+                fractionals *= 10;
+                unit *= 10;
+                unsafe_interval *= 10;
+                
+                digits[length++] = char('0' + (fractionals >> shift));
+                fractionals &= one - 1;
+                --kappa;
+                
+                if (fractionals < unsafe_interval) {
+                    exponent = kappa - c.k;
+                    return grisu_round_weed(digits, length, (too_high - scaled_w).f * unit, unsafe_interval, fractionals, one, unit);
+                }
+            }
+        }
         
-        const_iterator begin() const;
-        const_iterator end() const;
+        // Shortest digits of v > 0 by increasing the precision until the value round-trips.
+        inline void shortest_digits_fallback(double v, char *digits, int &length, int &exponent) {
+            char buf[number_buffer_size];
+            for (int precision = 1; precision <= 17; ++precision) {
+                std::snprintf(buf, sizeof(buf), "%.*e", precision - 1, v);
+                if (std::strtod(buf, nullptr) == v) break;
+            }
+            
+            // buf is d[.ddd]e[+-]xx, the decimal point may be locale specific.
+            const char *p = buf;
+            length = 0;
+            for (; *p != 'e'; ++p) {
+                if (*p >= '0' && *p <= '9') digits[length++] = *p;
+            }
+            while (length > 1 && digits[length - 1] == '0') {
+                --length;
+            }
+            exponent = std::atoi(p + 1) - (length - 1);
+        }
         
-        // Array inserters
-
-        void push_back(const jtype &v);
+        /**
+            Writes v as ECMAScript Number::toString() does, returns the end of the written characters.
+         
+            Uses the shortest digits that round-trip, for example 2, 0.1, 1e+21 and 1.5e-7.
+        */
+        inline char *format_number(double v, char *buf) {
+            if (v != v) {
+                return std::copy_n("NaN", 3, buf);
+            }
+            if (v == 0) {
+                *buf = '0';
+                return buf + 1;
+            }
+            if (v < 0) {
+                *buf++ = '-';
+                v = -v;
+            }
+            if (v > std::numeric_limits<double>::max()) {
+                return std::copy_n("Infinity", 8, buf);
+            }
+            
+            char digits[number_buffer_size];
+            int k, exponent;
+            if (!grisu3(v, digits, k, exponent)) {
+                shortest_digits_fallback(v, digits, k, exponent);
+            }
+            
+            // The decimal point goes after n digits.
+            const int n = k + exponent;
+            
+            if (k <= n && n <= 21) {
+                buf = std::copy_n(digits, k, buf);
+                return std::fill_n(buf, n - k, '0');
+            } else if (0 < n && n <= 21) {
+                buf = std::copy_n(digits, n, buf);
+                *buf++ = '.';
+                return std::copy_n(digits + n, k - n, buf);
+            } else if (-6 < n && n <= 0) {
+                *buf++ = '0';
+                *buf++ = '.';
+                buf = std::fill_n(buf, -n, '0');
+                return std::copy_n(digits, k, buf);
+            } else {
+                *buf++ = digits[0];
+                if (k > 1) {
+                    *buf++ = '.';
+                    buf = std::copy_n(digits + 1, k - 1, buf);
+                }
+                *buf++ = 'e';
+                *buf++ = n - 1 < 0 ? '-' : '+';
+                return format_number(std::uint64_t(n - 1 < 0 ? 1 - n : n - 1), buf);
+            }
+        }
         
-        // Comparison interface
+        /**
+            Escapes n characters at s for use inside a quoted JSON string.
+         
+            Unescaped runs are passed to append(const char *data, std::size_t length) as a
+            whole. Control characters without a short escape are written as \u00XX.
+        */
+        template<class Append>
+        inline void escape_json_string(const char *s, std::size_t n, Append &&append) {
+            static const char hex[] = "0123456789abcdef";
+            
+            const char *run = s;
+            const char *end = s + n;
+            for (const char *p = s; p != end; ++p) {
+                const unsigned char c = static_cast<unsigned char>(*p);
+                if (c >= 0x20 && c != '"' && c != '\\') continue;
+                
+                append(run, std::size_t(p - run));
+                run = p + 1;
+                switch (c) {
+                    case '"': append("\\\"", 2); break;
+                    case '\\': append("\\\\", 2); break;
+                    case '\b': append("\\b", 2); break;
+                    case '\f': append("\\f", 2); break;
+                    case '\n': append("\\n", 2); break;
+                    case '\r': append("\\r", 2); break;
+                    case '\t': append("\\t", 2); break;
+                    default: {
+                        const char u[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF]};
+                        append(u, sizeof(u));
+                        break;
+                    }
+                }
+            }
+            append(run, std::size_t(end - run));
+        }
         
-        bool operator==(jtype const& rhs) const;
-        bool operator!=(jtype const& rhs) const;
-        bool operator<(jtype const& rhs) const;
-        bool operator>(jtype const& rhs) const;
-        bool operator<=(jtype const& rhs) const;
-        bool operator>=(jtype const &rhs) const;
+        // Number read from a string by ECMAScript ToNumber().
+        struct number_literal {
+            double value;
+            std::uint64_t magnitude;   // exact absolute value when is_integer is set
+            bool negative;
+            bool is_integer;           // integer literal that fits into 64 bits
+        };
         
+        // Length in bytes of the ECMAScript white space or line terminator at p, 0 if there is none.
+        inline std::size_t space_length(const char *p, const char *last) {
+            const unsigned char c = static_cast<unsigned char>(*p);
+            if (c == ' ' || (c >= '\t' && c <= '\r')) return 1;
+            if (c < 0xC2) return 0;
+            
+            const std::ptrdiff_t n = last - p;
+            const unsigned char c1 = n > 1 ? static_cast<unsigned char>(p[1]) : 0;
+            const unsigned char c2 = n > 2 ? static_cast<unsigned char>(p[2]) : 0;
+            
+            if (c == 0xC2 && c1 == 0xA0) return 2;                                          // U+00A0
+            if (c == 0xE1 && c1 == 0x9A && c2 == 0x80) return 3;                            // U+1680
+            if (c == 0xE2 && c1 == 0x80 && (c2 <= 0x8A || c2 == 0xA8 || c2 == 0xA9 || c2 == 0xAF) && c2 >= 0x80) return 3; // U+2000-200A, U+2028, U+2029, U+202F
+            if (c == 0xE2 && c1 == 0x81 && c2 == 0x9F) return 3;                            // U+205F
+            if (c == 0xE3 && c1 == 0x80 && c2 == 0x80) return 3;                            // U+3000
+            if (c == 0xEF && c1 == 0xBB && c2 == 0xBF) return 3;                            // U+FEFF
+            return 0;
+        }
         
-        jtype size() const;
+        inline void trim_spaces(const char *&first, const char *&last) {
+            for (std::size_t n; first != last && (n = space_length(first, last)) > 0; first += n) {}
+            
+            while (first != last) {
+                if (space_length(last - 1, last) == 1) {
+                    last -= 1;
+                } else if (last - first >= 2 && space_length(last - 2, last) == 2) {
+                    last -= 2;
+                } else if (last - first >= 3 && space_length(last - 3, last) == 3) {
+                    last -= 3;
+                } else {
+                    break;
+                }
+            }
+        }
         
-        // Helper methods
+        inline int digit_value(char c) {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+            return 16;
+        }
         
-        jtype &merge_from(const jtype &other);
+        // Reads the digits of a 0x, 0o or 0b literal.
+        inline bool read_radix_number(const char *p, const char *last, int radix, number_literal &n) {
+            if (p == last) return false;
+            
+            std::uint64_t m = 0;
+            double d = 0;
+            bool exact = true;
+            for (; p != last; ++p) {
+                const int digit = digit_value(*p);
+                if (digit >= radix) return false;
+                
+                if (exact && m > (std::numeric_limits<std::uint64_t>::max() - std::uint64_t(digit)) / std::uint64_t(radix)) {
+                    exact = false;
+                    d = double(m);
+                }
+                if (exact) {
+                    m = m * std::uint64_t(radix) + std::uint64_t(digit);
+                } else {
+                    d = d * radix + digit;
+                }
+            }
+            
+            n.value = exact ? double(m) : d;
+            n.magnitude = m;
+            n.negative = false;
+            n.is_integer = exact;
+            return true;
+        }
         
-        jtype split(const jtype &separator) const;
+        /**
+            Reads [first, last) by the rules of ECMAScript ToNumber(), returns false where it yields NaN.
+         
+            Surrounding white space is ignored and an empty string reads as 0. Accepts decimal
+            literals with optional sign, fraction and exponent, Infinity, and unsigned 0x, 0o and
+            0b literals. Does not depend on the locale, does not allocate and does not throw.
+        */
+        inline bool read_number(const char *first, const char *last, number_literal &n) {
+            trim_spaces(first, last);
+            
+            n = number_literal{0.0, 0, false, true};
+            if (first == last) return true;
+            
+            const char *p = first;
+            if (last - p > 2 && p[0] == '0') {
+                switch (p[1]) {
+                    case 'x': case 'X': return read_radix_number(p + 2, last, 16, n);
+                    case 'o': case 'O': return read_radix_number(p + 2, last, 8, n);
+                    case 'b': case 'B': return read_radix_number(p + 2, last, 2, n);
+                }
+            }
+            
+            if (*p == '+' || *p == '-') {
+                n.negative = *p++ == '-';
+            }
+            
+            if (std::size_t(last - p) == 8 && std::equal(p, last, "Infinity")) {
+                n.value = n.negative ? -std::numeric_limits<double>::infinity() : std::numeric_limits<double>::infinity();
+                n.is_integer = false;
+                return true;
+            }
+            
+            // Significant digits are collected while they fit, value = mantissa * 10^exponent.
+            std::uint64_t mantissa = 0;
+            bool inexact = false;
+            long exponent = 0;
+            long fraction_digits = 0;
+            long explicit_exponent = 0;
+            
+            const char *digits = p;
+            const char *digits_end = p;
+            bool any_digit = false;
+            bool fraction = false;
+            
+            for (; p != last; ++p) {
+                if (*p == '.' && !fraction) {
+                    fraction = true;
+                    continue;
+                }
+                if (*p < '0' || *p > '9') break;
+                
+                any_digit = true;
+                digits_end = p + 1;
+                if (fraction) ++fraction_digits;
+                const int digit = *p - '0';
+                if (mantissa == 0 && digit == 0) {
+                    if (fraction) --exponent;
+                } else if (mantissa <= (std::numeric_limits<std::uint64_t>::max() - std::uint64_t(digit)) / 10) {
+                    mantissa = mantissa * 10 + std::uint64_t(digit);
+                    if (fraction) --exponent;
+                } else {
+                    inexact = inexact || digit != 0;
+                    if (!fraction) ++exponent;
+                }
+            }
+            if (!any_digit) return false;
+            
+            if (p != last && (*p == 'e' || *p == 'E')) {
+                ++p;
+                bool negative_exponent = false;
+                if (p != last && (*p == '+' || *p == '-')) {
+                    negative_exponent = *p++ == '-';
+                }
+                if (p == last) return false;
+                
+                long e = 0;
+                for (; p != last && *p >= '0' && *p <= '9'; ++p) {
+                    if (e < 100000) e = e * 10 + (*p - '0');
+                }
+                if (p != last) return false;
+                explicit_exponent = negative_exponent ? -e : e;
+                exponent += explicit_exponent;
+            }
+            if (p != last) return false;
+            
+            n.is_integer = false;
+            if (mantissa == 0) {
+                n.value = n.negative ? -0.0 : 0.0;
+                n.is_integer = true;
+                return true;
+            }
+            
+            // Trailing fraction zeros do not make a literal inexact, as in 5.0.
+            while (!inexact && exponent < 0 && mantissa % 10 == 0) {
+                mantissa /= 10;
+                ++exponent;
+            }
+            
+            if (!inexact && exponent >= 0 && exponent < 20) {
+                std::uint64_t m = mantissa;
+                long e = exponent;
+                for (; e > 0 && m <= std::numeric_limits<std::uint64_t>::max() / 10; --e) {
+                    m *= 10;
+                }
+                if (e == 0) {
+                    n.magnitude = m;
+                    n.is_integer = true;
+                }
+            }
+            
+            static const double pow10[] = {
+                1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+            };
+            
+            double v;
+            if (!inexact && mantissa <= (std::uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+                // Both operands are exact, so a single rounding gives the correct result.
+                v = exponent < 0 ? double(mantissa) / pow10[-exponent] : double(mantissa) * pow10[exponent];
+            } else {
+                // Correctly rounded by strtod. The digits are rewritten without a decimal point,
+                // which keeps the result independent of the locale. Digits beyond the 768th only
+                // decide rounding and are replaced by a sticky 1.
+                const int max_digits = 768;
+                char buf[max_digits + 32];
+                char *b = buf;
+                long shift = 0;
+                bool sticky = false;
+                for (const char *q = digits; q != digits_end; ++q) {
+                    if (*q == '.' || (b == buf && *q == '0')) continue;
+                    if (b - buf < max_digits - 1) {
+                        *b++ = *q;
+                    } else {
+                        sticky = sticky || *q != '0';
+                        ++shift;
+                    }
+                }
+                if (sticky) {
+                    *b++ = '1';
+                    --shift;
+                }
+                
+                *b++ = 'e';
+                b = format_number(std::int64_t(explicit_exponent - fraction_digits + shift), b);
+                *b = '\0';
+                v = std::strtod(buf, nullptr);
+            }
+            
+            n.value = n.negative ? -v : v;
+            return true;
+        }
         
-        jtype &at(const jtype &path);
-        const jtype &at(const jtype &path) const;
+        template<typename T>
+        inline meta::if_is_signed_integral<T, coerce_error> number_cast(const number_literal &n, T &out) {
+            using limits = std::numeric_limits<T>;
+            
+            if (n.is_integer) {
+                const std::uint64_t max = std::uint64_t(limits::max());
+                if (n.magnitude > (n.negative ? max + 1 : max)) return coerce_error::out_of_range;
+                out = n.negative ? T(std::int64_t(std::uint64_t(0) - n.magnitude)) : T(n.magnitude);
+                return coerce_error::none;
+            }
+            
+            // Fractions are truncated towards zero, the bounds are exact powers of two.
+            const double t = std::trunc(n.value);
+            if (!(t >= double(limits::min()) && t < -double(limits::min()))) return coerce_error::out_of_range;
+            out = T(t);
+            return coerce_error::none;
+        }
         
-        void clear();
-
-        const jtype& global_undefined() const;
+        template<typename T>
+        inline meta::if_is_unsigned_integral<T, coerce_error> number_cast(const number_literal &n, T &out) {
+            if (n.is_integer) {
+                if (n.magnitude > std::uint64_t(std::numeric_limits<T>::max()) || (n.negative && n.magnitude != 0)) return coerce_error::out_of_range;
+                out = T(n.magnitude);
+                return coerce_error::none;
+            }
+            
+            const double t = std::trunc(n.value);
+            if (!(t > -1.0 && t < (double(std::numeric_limits<T>::max() / 2 + 1) * 2))) return coerce_error::out_of_range;
+            out = T(t);
+            return coerce_error::none;
+        }
         
-    private:
-        typedef variant<
-        undefined_t,
-        null_t,
-        bool,
-        number_t,
-        std::string,
-        function_t,
-        array_t,
-        object_t
-        > oneof;
+        template<typename T>
+        inline meta::if_is_real<T, coerce_error> number_cast(const number_literal &n, T &out) {
+            out = T(n.value);
+            return coerce_error::none;
+        }
         
-        oneof _value;
-    };
-
-    inline bool operator<(const jtype::object_t &lhs, const jtype::object_t &rhs) { return false; }
-
-    
-    namespace details {
+        // Converts a numeric string to T following ECMAScript ToNumber().
+        template<typename T>
+        inline coerce_error string_to_number(const std::string &s, T &out) {
+            number_literal n;
+            if (!read_number(s.data(), s.data() + s.size(), n)) return coerce_error::invalid_number;
+            return number_cast(n, out);
+        }
 
-       
         template<typename Range, typename Transform>
         inline std::string
         join(const Range &input, const std::string& separator, Transform trans)
@@ -414,20 +2964,21 @@ namespace jtypes {
             auto it = std::begin(input);
             auto it_end = std::end(input);
             
-            std::ostringstream result;
+            std::string result;
             
             if(it != it_end)
             {
-                result << trans(*it);
+                result += trans(*it);
                 ++it;
             }
             
             for(;it != it_end; ++it)
             {
-                result << separator << trans(*it);
+                result += separator;
+                result += trans(*it);
             }
             
-            return result.str();
+            return result;
         }
         
         template<typename Range>
@@ -460,30 +3011,15 @@ namespace jtypes {
             NumberType operator()(const bool &v) const { return v ? NumberType(1) : NumberType(0); }
             
             
-            template< typename T = NumberType >
-            NumberType operator()(const std::string &v, meta::if_is_signed_integral<T> *unused=0) const {
-                try {
-                    return NumberType(std::stol(v));
-                } catch (std::exception) {
-                    throw type_error("failed to coerce type from string to integral type");
-                }
-            }
-            
-            template< typename T = NumberType >
-            NumberType operator()(const std::string &v, meta::if_is_unsigned_integral<T> *unused=0) const {
-                try {
-                    return NumberType(std::stoul(v));
-                } catch (std::exception) {
-                    throw type_error("failed to coerce type from string to integral type");
-                }
-            }
-            
-            template< typename T = NumberType >
-            NumberType operator()(const std::string &v, meta::if_is_real<T> *unused=0) const {
-                try {
-                    return NumberType(std::stod(v));
-                } catch (std::exception) {
-                    throw type_error("failed to coerce type from string to integral type");
+            NumberType operator()(const std::string &v) const {
+                NumberType n;
+                switch (string_to_number(v, n)) {
+                    case coerce_error::none:
+                        return n;
+                    case coerce_error::out_of_range:
+                        throw type_error("failed to coerce string to number, value out of range");
+                    default:
+                        throw type_error("failed to coerce string to number");
                 }
             }
             
@@ -492,10 +3028,6 @@ namespace jtypes {
                 return NumberType(t); // Static cast needs to be addressed.
             }
             
-            NumberType operator()(const jtype::number_t &v) const {
-                return apply_visitor(*this, v);
-            }
-            
             template<class T>
             NumberType operator()(const T &t, meta::if_not_is_number_t<T> *unused=0) const {
                 throw type_error("failed to coerce type to integral type");
@@ -517,37 +3049,100 @@ namespace jtypes {
             template<class T>
             bool operator()(const T &v, meta::if_is_number_t<T> *unused=0) const { return v != T(0); };
             
-            bool operator()(const jtype::number_t &v) const {
-                return apply_visitor(*this, v);
+        };
+        
+        // Appends the string coercion of the visited value to out. Nested arrays are
+        // written into the same buffer instead of through temporary strings.
+        struct append_coerced_string {
+            std::string &out;
+            
+            void operator()(const jtype::undefined_t &v) const { out += "undefined"; }
+            void operator()(const jtype::null_t &v) const { out += "null"; }
+            void operator()(const bool &v) const { out += v ? "true" : "false"; }
+            void operator()(const std::string &v) const { out += v; }
+            void operator()(const jtype::function_t &v) const { out += "function"; }
+            void operator()(const jtype::object_t &v) const { out += "object"; }
+            
+            void operator()(const jtype::array_t &v) const {
+                bool first = true;
+                for (auto && e : v) {
+                    if (!first) out += ',';
+                    first = false;
+                    e.visit(*this);
+                }
+            }
+            
+            template<class T>
+            void operator()(const T &v, meta::if_is_number_t<T> *unused=0) const {
+                char buf[number_buffer_size];
+                out.append(buf, format_number(v, buf));
             }
         };
         
         template<>
         struct coerce<std::string> {
             jtype opts;
-           
-            std::string operator()(const jtype::undefined_t &v) const { return "undefined"; }
-            std::string operator()(const jtype::null_t &v) const { return "null"; }
-            std::string operator()(const bool &v) const { return v ? "true" : "false"; }
+            
             std::string operator()(const std::string &v) const { return v; }
-            std::string operator()(const jtype::function_t &v) const { return "function"; }
-            std::string operator()(const jtype::array_t &v) const {
-                return join(v, ",", [](const jtype &vv) { return vv.as<std::string>(); });
+            
+            template<class T>
+            std::string operator()(const T &v) const {
+                std::string s;
+                append_coerced_string visitor = {s};
+                visitor(v);
+                return s;
+            }
+        };
+        
+        // Visitor that stores the converted value in out and returns why it failed otherwise.
+        template<typename NumberType>
+        struct try_coerce {
+            NumberType &out;
+            
+            coerce_error operator()(const bool &v) const {
+                out = v ? NumberType(1) : NumberType(0);
+                return coerce_error::none;
+            }
+            
+            coerce_error operator()(const std::string &v) const {
+                return string_to_number(v, out);
             }
-
-            std::string operator()(const jtype::object_t &v) const { return "object"; }
             
             template<class T>
-            std::string operator()(const T &v, meta::if_is_number_t<T> *unused=0) const {
-                return std::to_string(v); 
-            };
-
+            coerce_error operator()(const T &t, meta::if_is_number_t<T> *unused=0) const {
+                out = NumberType(t);
+                return coerce_error::none;
+            }
             
-            std::string operator()(const jtype::number_t &v) const {
-                return apply_visitor(*this, v);
+            template<class T>
+            coerce_error operator()(const T &t, meta::if_not_is_number_t<T> *unused=0) const {
+                return coerce_error::invalid_type;
             }
         };
-
+        
+        // Coercions to bool and string never fail.
+        template<>
+        struct try_coerce<bool> {
+            bool &out;
+            
+            template<class T>
+            coerce_error operator()(const T &v) const {
+                out = coerce<bool>()(v);
+                return coerce_error::none;
+            }
+        };
+        
+        template<>
+        struct try_coerce<std::string> {
+            std::string &out;
+            
+            template<class T>
+            coerce_error operator()(const T &v) const {
+                out = coerce<std::string>()(v);
+                return coerce_error::none;
+            }
+        };
+        
         struct equal_numbers {
 
             bool operator()(std::int64_t lhs, std::uint64_t rhs) const {
@@ -579,25 +3174,90 @@ namespace jtypes {
                 return (lhs < 0) ? true : (std::uint64_t)lhs < rhs;
             }
             
-            bool operator()(std::uint64_t lhs, std::int64_t rhs) const {
-                return (rhs < 0) ? false : lhs < (std::uint64_t)rhs;
-            }
+            bool operator()(std::uint64_t lhs, std::int64_t rhs) const {
+                return (rhs < 0) ? false : lhs < (std::uint64_t)rhs;
+            }
+            
+            bool operator()(std::uint64_t lhs, double rhs) const {
+                return (rhs < 0.0) ? false : (double)lhs < rhs;
+            }
+            
+            bool operator()(double lhs, std::uint64_t rhs) const {
+                return (lhs < 0) ? true : lhs < (double)rhs;
+            }
+            
+            template<class T, class U>
+            bool operator()(T rhs, U lhs) const {
+                return rhs < lhs;
+            }
+            
+        };
+        
+        struct equal_values {
+            
+            bool operator()(const jtype::null_t &lhs, const jtype::null_t &rhs) const { return true; }
+            
+            template<class T>
+            bool operator()(const T &lhs, const T &rhs) const { return lhs == rhs; }
+            
+            template<class T, class U>
+            bool operator()(const T &lhs, const U &rhs) const { return mixed(lhs, rhs, meta::are_number_t<T, U>()); }
+            
+        private:
+            template<class T, class U>
+            bool mixed(const T &lhs, const U &rhs, std::true_type) const { return equal_numbers()(lhs, rhs); }
+            
+            template<class T, class U>
+            bool mixed(const T &lhs, const U &rhs, std::false_type) const { return false; }
+        };
+        
+        struct less_values {
+            
+            bool operator()(const jtype::null_t &lhs, const jtype::null_t &rhs) const { return false; }
+            
+            template<class T>
+            bool operator()(const T &lhs, const T &rhs) const { return lhs < rhs; }
             
-            bool operator()(std::uint64_t lhs, double rhs) const {
-                return (rhs < 0.0) ? false : (double)lhs < rhs;
-            }
+            template<class T, class U>
+            bool operator()(const T &lhs, const U &rhs) const { return mixed(lhs, rhs, meta::are_number_t<T, U>()); }
             
-            bool operator()(double lhs, std::uint64_t rhs) const {
-                return (lhs < 0) ? true : lhs < (double)rhs;
-            }
+        private:
+            template<class T, class U>
+            bool mixed(const T &lhs, const U &rhs, std::true_type) const { return less_numbers()(lhs, rhs); }
             
             template<class T, class U>
-            bool operator()(T rhs, U lhs) const {
-                return rhs < lhs;
-            }
+            bool mixed(const T &lhs, const U &rhs, std::false_type) const { return type_tag<T>::value < type_tag<U>::value; }
+        };
+        
+        // Double dispatch of a binary predicate over the stored alternatives of two jtypes.
+        
+        template<typename Predicate, typename T>
+        struct bind_lhs {
+            const Predicate &pred;
+            const T &lhs;
+            
+            template<class U>
+            bool operator()(const U &rhs) const { return pred(lhs, rhs); }
+        };
+        
+        template<typename Predicate>
+        struct bind_rhs {
+            const Predicate &pred;
+            const jtype &rhs;
             
+            template<class T>
+            bool operator()(const T &lhs) const {
+                bind_lhs<Predicate, T> visitor = {pred, lhs};
+                return rhs.visit(visitor);
+            }
         };
         
+        template<typename Predicate>
+        inline bool visit_pair(const Predicate &pred, const jtype &lhs, const jtype &rhs) {
+            bind_rhs<Predicate> visitor = {pred, rhs};
+            return lhs.visit(visitor);
+        }
+        
         template<class Iter>
         inline jtype create_array(Iter begin, Iter end) {
             using value_type = typename std::decay< decltype(*begin) >::type;
@@ -627,53 +3287,94 @@ namespace jtypes {
             return jtype(std::move(o));
         }
         
+        enum class iterator_kind : std::uint8_t { none, array, object };
+        
+        /**
+            Bidirectional iterator over the elements of an array or the property values of
+            an object.
+         
+            The kind of container is fixed at construction, so incrementing and
+            dereferencing only branch on a plain flag. Like standard iterators, a default
+            constructed iterator must not be dereferenced. For random access to arrays
+            use jtype::elements().
+        */
         template<typename Type, typename UnqualifiedType>
-        class var_iterator : public std::iterator<std::forward_iterator_tag, UnqualifiedType, std::ptrdiff_t, Type*, Type&> {
+        class var_iterator : public std::iterator<std::bidirectional_iterator_tag, UnqualifiedType, std::ptrdiff_t, Type*, Type&> {
         public:
             using array_iterator = typename std::conditional<std::is_const<Type>::value, jtype::array_t::const_iterator, jtype::array_t::iterator>::type;
             using object_iterator = typename std::conditional<std::is_const<Type>::value, jtype::object_t::const_iterator, jtype::object_t::iterator>::type;
             
             var_iterator()
-            :_iter(mapbox::util::no_init())
+            : _kind(kind::none), _index(0)
             {}
             
             explicit var_iterator(const array_iterator &i, std::uint64_t offset)
-            :_iter(index_array_iter_pair(offset, i))
+            : _kind(kind::array), _array(i), _index(offset)
             {}
             
             explicit var_iterator(const object_iterator &i)
-            :_iter(i)
+            : _kind(kind::object), _object(i), _index(0)
             {}
             
             void swap(var_iterator& other) noexcept
             {
                 using std::swap;
-                swap(_iter, other._iter);
+                swap(_kind, other._kind);
+                swap(_array, other._array);
+                swap(_object, other._object);
+                swap(_index, other._index);
             }
             
             var_iterator& operator++ () // Pre-increment
             {
-                inc();
+                if (_kind == kind::array) {
+                    ++_index;
+                    ++_array;
+                } else {
+                    ++_object;
+                }
                 return *this;
             }
             
             var_iterator operator++ (int) // Post-increment
             {
                 var_iterator tmp(*this);
-                inc();
+                ++*this;
+                return tmp;
+            }
+            
+            var_iterator& operator-- () // Pre-decrement
+            {
+                if (_kind == kind::array) {
+                    --_index;
+                    --_array;
+                } else {
+                    --_object;
+                }
+                return *this;
+            }
+            
+            var_iterator operator-- (int) // Post-decrement
+            {
+                var_iterator tmp(*this);
+                --*this;
                 return tmp;
             }
             
+            // Array positions are compared by index, which also works across constness.
             template<class OtherType>
             bool operator == (const var_iterator<OtherType>& rhs) const
             {
-                if (_iter.valid() || rhs._iter.valid()) {
-                    return _iter == rhs._iter;
+                if (_kind != rhs._kind) {
+                    return false;
+                } else if (_kind == kind::array) {
+                    return _index == rhs._index;
+                } else if (_kind == kind::object) {
+                    return _object == rhs._object;
                 } else {
                     // Both are invalid
                     return true;
                 }
-                
             }
             
             template<class OtherType>
@@ -683,75 +3384,67 @@ namespace jtypes {
             }
             
             jtype key() const {
-                if (!_iter.valid())
-                    throw type_error("key() requires a valid iterator");
+                check_valid("key() requires a valid iterator");
                 
-                if (_iter.which() == 0) {
-                    return _iter.template get<index_array_iter_pair>().first;
+                if (_kind == kind::array) {
+                    return _index;
                 } else {
-                    return _iter.template get<object_iterator>()->first;
+                    return key_string(_object->first);
                 }
             }
             
-            Type& value() const {
-                if (!_iter.valid())
-                    throw type_error("value() requires a valid iterator");
+            // Key without copying the property name.
+            jtypes::key_ref key_ref() const {
+                check_valid("key_ref() requires a valid iterator");
                 
-                if (_iter.which() == 0) {
-                    return *_iter.template get<index_array_iter_pair>().second;
+                if (_kind == kind::array) {
+                    return jtypes::key_ref(_index);
                 } else {
-                    return _iter.template get<object_iterator>()->second;
+                    return jtypes::key_ref(key_string(_object->first));
                 }
             }
             
+            Type& value() const {
+                check_valid("value() requires a valid iterator");
+                return **this;
+            }
+            
             Type& operator* () const
             {
-                if (!_iter.valid())
-                    throw type_error("accessing iterator's value requires a valid iterator");
-                
-                if (_iter.which() == 0) {
-                    return *_iter.template get<index_array_iter_pair>().second;
-                } else {
-                    return _iter.template get<object_iterator>()->second;
-                }
+                return _kind == kind::array ? *_array : _object->second;
             }
             
             Type* operator-> () const
             {
-                if (!_iter.valid())
-                    throw type_error("accessing iterator's value requires a valid iterator");
-                
-                if (_iter.which() == 0) {
-                    return &(*_iter.template get<index_array_iter_pair>().second);
-                } else {
-                    return &(_iter.template get<object_iterator>()->second);
-                }
+                return &**this;
             }
             
             operator var_iterator<const UnqualifiedType>() const
             {
-                return var_iterator<const UnqualifiedType>(_iter);
+                if (_kind == kind::array) {
+                    return var_iterator<const UnqualifiedType>(_array, _index);
+                } else if (_kind == kind::object) {
+                    return var_iterator<const UnqualifiedType>(_object);
+                } else {
+                    return var_iterator<const UnqualifiedType>();
+                }
             }
             
         private:
+            template<typename, typename>
+            friend class var_iterator;
             
-            void inc() {
-                if (_iter.which() == 0) {
-                    auto &r = _iter.template get<index_array_iter_pair>();
-                    ++r.first;
-                    ++r.second;
-                } else  {
-                    ++_iter.template get<object_iterator>();
-                }
-            }
-            
-            using index_array_iter_pair = std::pair<std::uint64_t, array_iterator>;
+            using kind = iterator_kind;
             
-            var_iterator(const variant<index_array_iter_pair, object_iterator> &other)
-            :_iter(other)
-            {}
+            void check_valid(const char *what) const {
+                if (_kind == kind::none)
+                    throw type_error(what);
+            }
             
-            variant<index_array_iter_pair, object_iterator> _iter;
+            kind _kind;
+            array_iterator _array;
+            object_iterator _object;
+            std::uint64_t _index;
         };
         
         inline bool merge(jtype &dst, const jtype &src) {
@@ -793,17 +3486,17 @@ namespace jtypes {
     
     template<typename I>
     inline jtype::jtype(I t, typename meta::if_is_signed_integral<I>* unused)
-    : _value(number_t(static_cast<int64_t>(t))) {
+    : _value(static_cast<std::int64_t>(t)) {
     }
     
     template<typename I>
     inline jtype::jtype(I t, typename meta::if_is_unsigned_integral<I>* unused)
-    : _value(number_t(static_cast<uint64_t>(t))) {
+    : _value(static_cast<std::uint64_t>(t)) {
     }
     
     template<typename I>
     inline jtype::jtype(I t, typename meta::if_is_real<I>* unused)
-    : _value(number_t(static_cast<double>(t))) {
+    : _value(static_cast<double>(t)) {
     }
 
     template<class Sig, typename>
@@ -835,6 +3528,10 @@ namespace jtypes {
     inline jtype::jtype(undefined_t &&v)
         : _value(std::move(v))             
     {}
+    
+    inline jtype::jtype(jtype &&rhs) noexcept
+        : _value(std::move(rhs._value))
+    {}
 
     inline jtype::jtype(const function_t & v) 
         :_value(v)
@@ -861,6 +3558,13 @@ namespace jtypes {
         :_value(std::move(v))
     {}
    
+    inline jtype &jtype::operator=(jtype &&rhs) noexcept {
+        // rhs might be owned by this, e.g. x = std::move(x["a"]). Detach first.
+        oneof tmp(std::move(rhs._value));
+        _value = std::move(tmp);
+        return *this;
+    }
+    
     inline jtype &jtype::operator=(std::nullptr_t) {
         _value = nullptr;
         return *this;
@@ -886,6 +3590,11 @@ namespace jtypes {
         return *this;
     }
     
+    inline jtype &jtype::operator=(std::string &&rhs) {
+        _value = std::move(rhs);
+        return *this;
+    }
+    
     inline jtype &jtype::operator=(const array_t &rhs) {
         _value = rhs;
         return *this;
@@ -930,47 +3639,37 @@ namespace jtypes {
     template<typename I>
     inline meta::if_is_signed_integral<I, jtype&>
     jtype::operator=(I t) {
-        _value = number_t(static_cast<int64_t>(t));
+        _value = static_cast<std::int64_t>(t);
         return *this;
     }
     
     template<typename I>
     inline meta::if_is_unsigned_integral<I, jtype&>
     jtype::operator=(I t) {
-        _value = number_t(static_cast<uint64_t>(t));
+        _value = static_cast<std::uint64_t>(t);
         return *this;
     }
     
     template<typename I>
     inline meta::if_is_real<I, jtype&>
     jtype::operator=(I t) {
-        _value = number_t(static_cast<double>(t));
+        _value = static_cast<double>(t);
         return *this;
     }
     
     
     inline jtype::vtype jtype::type() const {
-        if      (is_undefined()) return vtype::undefined;
-        else if (is_null()) return vtype::null;
-        else if (is_boolean()) return vtype::boolean;
-        else if (is_signed_number()) return vtype::signed_number;
-        else if (is_unsigned_number()) return vtype::unsigned_number;
-        else if (is_real_number()) return vtype::real_number;
-        else if (is_string()) return vtype::string;
-        else if (is_function()) return vtype::function;
-        else if (is_array()) return vtype::array;
-        else if (is_object()) return vtype::object;
-        
-        throw range_error("type() unknown type");
+        // Alternatives are stored in the order of vtype.
+        return static_cast<vtype>(_value.which());
     }
     
     inline bool jtype::is_undefined() const { return _value.is<undefined_t>(); }
     inline bool jtype::is_null() const { return _value.is<null_t>(); }
     inline bool jtype::is_boolean() const { return _value.is<bool>(); }
-    inline bool jtype::is_number() const { return _value.is<number_t>(); }
-    inline bool jtype::is_signed_number() const { return is_number() && _value.get<number_t>().is<std::int64_t>(); }
-    inline bool jtype::is_unsigned_number() const { return is_number() && _value.get<number_t>().is<std::uint64_t>(); }
-    inline bool jtype::is_real_number() const { return is_number() && _value.get<number_t>().is<double>(); }
+    inline bool jtype::is_number() const { vtype t = type(); return t >= vtype::signed_number && t <= vtype::real_number; }
+    inline bool jtype::is_signed_number() const { return _value.is<std::int64_t>(); }
+    inline bool jtype::is_unsigned_number() const { return _value.is<std::uint64_t>(); }
+    inline bool jtype::is_real_number() const { return _value.is<double>(); }
     inline bool jtype::is_string() const { return _value.is<std::string>(); }
     inline bool jtype::is_function() const { return _value.is<function_t>(); }
     inline bool jtype::is_array() const { return _value.is<array_t>(); }
@@ -995,7 +3694,7 @@ namespace jtypes {
     inline meta::if_not_is_function<T, T> jtype::as(const jtype &opts) const
     {
         details::coerce<T> visitor = {opts};
-        return apply_visitor(visitor, _value);
+        return visit(visitor);
     }
     
     template<typename T>
@@ -1008,6 +3707,58 @@ namespace jtypes {
         return f.as<T>();
     }
     
+    template<typename T>
+    inline optional<T> jtype::try_as() const
+    {
+        coerce_error error;
+        return try_as<T>(error);
+    }
+    
+    template<typename T>
+    inline optional<T> jtype::try_as(coerce_error &error) const
+    {
+        T value = T();
+        details::try_coerce<T> visitor = {value};
+        error = visit(visitor);
+        return error == coerce_error::none ? optional<T>(std::move(value)) : optional<T>();
+    }
+    
+    /**
+        Appends v.as<std::string>() to out without building intermediate strings.
+     
+        Nested arrays are formatted into out directly. Reusing out for many values
+        also reuses its capacity.
+    */
+    inline void append_string(const jtype &v, std::string &out)
+    {
+        details::append_coerced_string visitor = {out};
+        v.visit(visitor);
+    }
+    
+    template<typename T>
+    inline T *jtype::get_if()
+    {
+        return _value.is<T>() ? &_value.get<T>() : nullptr;
+    }
+    
+    template<typename T>
+    inline const T *jtype::get_if() const
+    {
+        return _value.is<T>() ? &_value.get<T>() : nullptr;
+    }
+    
+    template<typename Visitor>
+    inline auto jtype::visit(Visitor &&v) -> decltype(v(std::declval<undefined_t&>()))
+    {
+        return details::visit_value(std::forward<Visitor>(v), _value);
+    }
+    
+    template<typename Visitor>
+    inline auto jtype::visit(Visitor &&v) const -> decltype(v(std::declval<const undefined_t&>()))
+    {
+        return details::visit_value(std::forward<Visitor>(v), _value);
+    }
+    
     template<typename Sig, typename... Args>
     inline typename meta::result_of_sig<Sig>::type jtype::invoke(Args&&... args) const
     {
@@ -1033,15 +3784,74 @@ namespace jtypes {
             }
             return a[idx];
         } else if (key.is_string() && is_object()) {
-            object_t &o = _value.get<object_t>();
-            auto iter = o.insert(object_t::value_type(key.as<std::string>(), jtype()));
-            return iter.first->second;
+            return details::find_or_insert(_value.get<object_t>(), key._value.get<std::string>());
         } else {
             throw type_error("operator[] key type and structured jtype type do not match");
         }
         
     }
     
+    inline jtype &jtype::operator[](jtype &&key) {
+        if (!key.is_string() || !is_object()) {
+            return (*this)[static_cast<const jtype&>(key)];
+        }
+        
+        // Move the key into the object when a new property is inserted.
+        return details::find_or_insert(_value.get<object_t>(), std::move(key._value.get<std::string>()));
+    }
+    
+    template<typename Atom>
+    inline meta::if_is_atom<Atom, jtype&> jtype::operator[](const Atom &key) {
+        if (!is_object()) {
+            throw type_error("operator[] with atom requires object type");
+        }
+        return details::find_or_insert(_value.get<object_t>(), key);
+    }
+    
+    template<typename Atom>
+    inline meta::if_is_atom<Atom, const jtype&> jtype::operator[](const Atom &key) const {
+        if (!is_object()) {
+            throw type_error("operator[] with atom requires object type");
+        }
+        
+        const object_t &o = _value.get<object_t>();
+        auto iter = o.find(details::lookup_key(key));
+        return iter != o.end() ? iter->second : jtype::global_undefined();
+    }
+    
+    template<typename String>
+    inline meta::if_is_string<String, jtype&> jtype::operator[](String &&key) {
+        if (!is_object()) {
+            throw type_error(is_array() ? "operator[] key type and structured jtype type do not match" : "operator[] requires a structured type");
+        }
+        return details::find_or_insert(_value.get<object_t>(), std::forward<String>(key));
+    }
+    
+    template<typename String>
+    inline meta::if_is_string<String, const jtype&> jtype::operator[](const String &key) const {
+        if (!is_object()) {
+            throw type_error(is_array() ? "operator[] key type and structured jtype type do not match." : "operator[] requires a structured type.");
+        }
+        
+        const object_t &o = _value.get<object_t>();
+        auto iter = o.find(details::lookup_key(key));
+        return iter != o.end() ? iter->second : jtype::global_undefined();
+    }
+    
+    template<std::size_t N>
+    inline jtype &jtype::operator[](const char (&key)[N]) {
+        std::string &buffer = details::key_buffer();
+        buffer.assign(key);
+        return (*this)[static_cast<const std::string&>(buffer)];
+    }
+    
+    template<std::size_t N>
+    inline const jtype &jtype::operator[](const char (&key)[N]) const {
+        std::string &buffer = details::key_buffer();
+        buffer.assign(key);
+        return (*this)[buffer];
+    }
+    
     inline const jtype &jtype::operator[](const jtype &key) const {
         
         if (!is_structured()) {
@@ -1059,7 +3869,7 @@ namespace jtypes {
         } else if (key.is_string() && is_object()) {
             const object_t &o = _value.get<object_t>();
             
-            auto iter = o.find(key.as<std::string>());
+            auto iter = o.find(details::lookup_key(key._value.get<std::string>()));
             
             if (iter != o.end()) {
                 return iter->second;
@@ -1079,17 +3889,127 @@ namespace jtypes {
         a.push_back(v);
     }
     
+    inline void jtype::push_back(jtype &&v) {
+        if (!is_array())
+            throw type_error("push_back() requires array type.");
+        
+        array_t &a = _value.get<array_t>();
+        a.push_back(std::move(v));
+    }
+    
+    template<typename ...Args>
+    inline jtype &jtype::emplace_back(Args && ... args) {
+        if (!is_array())
+            throw type_error("emplace_back() requires array type.");
+        
+        array_t &a = _value.get<array_t>();
+        a.emplace_back(std::forward<Args>(args)...);
+        return a.back();
+    }
+    
+#if defined(JTYPES_COPY_ON_WRITE)
+    // The modified container is assembled first and wrapped afterwards, so that the new
+    // version shares all untouched elements and stays shareable.
+    inline jtype jtype::with(const jtype &key, jtype value) const {
+        if (key.is_number() && is_array()) {
+            array_t a = details::peek_value<array_t>(_value);
+            size_t idx = key.as<size_t>();
+            if (a.size() < idx + 1) {
+                a.resize(idx + 1);
+            }
+            a[idx] = std::move(value);
+            return jtype(std::move(a));
+        } else if (key.is_string() && is_object()) {
+            object_t o = details::peek_value<object_t>(_value);
+            details::find_or_insert(o, key._value.get<std::string>()) = std::move(value);
+            return jtype(std::move(o));
+        } else {
+            throw type_error("with() key type and structured jtype type do not match");
+        }
+    }
+    
+    inline jtype jtype::push(jtype value) const {
+        if (!is_array())
+            throw type_error("push() requires array type.");
+        
+        const array_t &src = details::peek_value<array_t>(_value);
+        array_t a;
+        a.reserve(src.size() + 1);
+        a.insert(a.end(), src.begin(), src.end());
+        a.push_back(std::move(value));
+        return jtype(std::move(a));
+    }
+#endif
+    
 
+    inline const jtype *jtype::find(const jtype &key) const {
+        if (key.is_number() && is_array()) {
+            const array_t &a = _value.get<array_t>();
+            const size_t idx = key.as<size_t>();
+            return idx < a.size() ? &a[idx] : nullptr;
+        } else if (key.is_string()) {
+            return find(key._value.get<std::string>());
+        }
+        return nullptr;
+    }
+    
+    inline jtype *jtype::find(const jtype &key) {
+        const jtype *p = static_cast<const jtype&>(*this).find(key);
+#if defined(JTYPES_COPY_ON_WRITE)
+        // Detach shared payloads only when the key is present.
+        return p ? &(*this)[key] : nullptr;
+#else
+        return const_cast<jtype*>(p);
+#endif
+    }
+    
+    template<typename String>
+    inline meta::if_is_string<String, const jtype*> jtype::find(const String &key) const {
+        if (!is_object()) {
+            return nullptr;
+        }
+        
+        const object_t &o = _value.get<object_t>();
+        auto iter = o.find(details::lookup_key(key));
+        return iter != o.end() ? &iter->second : nullptr;
+    }
+    
+    template<typename String>
+    inline meta::if_is_string<String, jtype*> jtype::find(const String &key) {
+        const jtype *p = static_cast<const jtype&>(*this).find(key);
+#if defined(JTYPES_COPY_ON_WRITE)
+        return p ? &(*this)[key] : nullptr;
+#else
+        return const_cast<jtype*>(p);
+#endif
+    }
+    
+    template<std::size_t N>
+    inline const jtype *jtype::find(const char (&key)[N]) const {
+        std::string &buffer = details::key_buffer();
+        buffer.assign(key);
+        return find(static_cast<const std::string&>(buffer));
+    }
+    
+    template<std::size_t N>
+    inline jtype *jtype::find(const char (&key)[N]) {
+        std::string &buffer = details::key_buffer();
+        buffer.assign(key);
+        return find(static_cast<const std::string&>(buffer));
+    }
+    
     inline jtype::array_t jtype::keys() const {
         array_t r;
         
         if (is_object()) {
             const object_t &o = _value.get<object_t>();
-            for (auto p : o) {
-                r.push_back(jtype(p.first));
+            r.reserve(o.size());
+            for (auto &p : o) {
+                r.push_back(jtype(details::key_string(p.first)));
             }
         } else if (is_array()) {
             const array_t &a = _value.get<array_t>();
+            r.reserve(a.size());
             for (size_t i = 0; i < a.size(); ++i) {
                 r.push_back(jtype(i));
             }
@@ -1103,8 +4023,10 @@ namespace jtypes {
         array_t r;
         
         if (is_object()) {
-            for (auto k : keys()) {
-                r.push_back((*this)[k]);
+            const object_t &o = _value.get<object_t>();
+            r.reserve(o.size());
+            for (auto &p : o) {
+                r.push_back(p.second);
             }
         } else if (is_array()) {
             r = _value.get<array_t>();
@@ -1112,6 +4034,62 @@ namespace jtypes {
         return r;
     }
     
+    inline jtype::keys_range jtype::keys_view() const {
+        return keys_range(keys_range::iterator(begin()), keys_range::iterator(end()));
+    }
+    
+    inline jtype::values_range jtype::values_view() {
+        return values_range(begin(), end());
+    }
+    
+    inline jtype::const_values_range jtype::values_view() const {
+        return const_values_range(begin(), end());
+    }
+    
+    inline jtype::items_range jtype::items() {
+        return items_range(items_range::iterator(begin()), items_range::iterator(end()));
+    }
+    
+    inline jtype::const_items_range jtype::items() const {
+        return const_items_range(const_items_range::iterator(begin()), const_items_range::iterator(end()));
+    }
+    
+    inline jtype::elements_range jtype::elements() {
+        if (!is_array())
+            throw type_error("elements() requires array type");
+        
+        array_t &a = _value.get<array_t>();
+        return elements_range(a.begin(), a.end());
+    }
+    
+    inline jtype::const_elements_range jtype::elements() const {
+        if (!is_array())
+            throw type_error("elements() requires array type");
+        
+        const array_t &a = _value.get<array_t>();
+        return const_elements_range(a.begin(), a.end());
+    }
+    
+    inline jtype::properties_range jtype::properties() {
+        if (!is_object())
+            throw type_error("properties() requires object type");
+        
+        object_t &o = _value.get<object_t>();
+        return properties_range(o.begin(), o.end());
+    }
+    
+    inline jtype::const_properties_range jtype::properties() const {
+        if (!is_object())
+            throw type_error("properties() requires object type");
+        
+        const object_t &o = _value.get<object_t>();
+        return const_properties_range(o.begin(), o.end());
+    }
+    
+    inline key_ref::operator jtype() const {
+        return is_index() ? jtype(_index) : jtype(*_name);
+    }
+    
     inline jtype::iterator jtype::begin() {
         
         if (!is_structured()) {
@@ -1154,12 +4132,25 @@ namespace jtypes {
     }
     
 
-    inline bool jtype::operator==(jtype const& rhs) const {
-        if (is_number() && rhs.is_number()) {
-            return mapbox::util::apply_visitor(details::equal_numbers(), _value.get<number_t>(), rhs._value.get<number_t>());
-        } else {
-            return _value == rhs._value;
+    // Scalars of the same kind, the common case for elements of homogeneous arrays, are
+    // compared without double dispatch. Arrays do not track element kinds, unboxed
+    // numeric storage is provided by the typed arrays of jtypes_typed.hpp.
+    template<typename Predicate>
+    inline bool jtype::compare(const Predicate &pred, const jtype &rhs) const {
+        if (_value.which() == rhs._value.which()) {
+            switch (_value.which()) {
+                case details::type_tag<std::int64_t>::value: return pred(_value.get<std::int64_t>(), rhs._value.get<std::int64_t>());
+                case details::type_tag<std::uint64_t>::value: return pred(_value.get<std::uint64_t>(), rhs._value.get<std::uint64_t>());
+                case details::type_tag<double>::value: return pred(_value.get<double>(), rhs._value.get<double>());
+                case details::type_tag<bool>::value: return pred(_value.get<bool>(), rhs._value.get<bool>());
+                default: break;
+            }
         }
+        return details::visit_pair(pred, *this, rhs);
+    }
+    
+    inline bool jtype::operator==(jtype const& rhs) const {
+        return compare(details::equal_values(), rhs);
     }
     
     inline bool jtype::operator!=(jtype const& rhs) const {
@@ -1167,11 +4158,7 @@ namespace jtypes {
     }
     
     inline bool jtype::operator<(jtype const& rhs) const {
-        if (is_number() && rhs.is_number()) {
-            return mapbox::util::apply_visitor(details::less_numbers(), _value.get<number_t>(), rhs._value.get<number_t>());
-        } else {
-            return _value < rhs._value;
-        }
+        return compare(details::less_values(), rhs);
     }
     
     inline bool jtype::operator>(jtype const& rhs) const {
@@ -1191,9 +4178,9 @@ namespace jtypes {
             throw type_error("size() requires a structured type");
         
         if (is_array()) {
-            return _value.get<array_t>().size();
+            return details::peek_value<array_t>(_value).size();
         } else {
-            return _value.get<object_t>().size();
+            return details::peek_value<object_t>(_value).size();
         }
     }
     
@@ -1222,50 +4209,127 @@ namespace jtypes {
             return (*this)[path];
         }
         
-        jtype elems = path.is_array() ? path : jtype(path.as<std::string>()).split('.');
+        return at(jtype::path(path, jtype::path::lookup_only()));
+    }
+    
+    
+    inline const jtype &jtype::at(const jtype &path) const {
+        if (!is_structured())
+            throw type_error("at() requires structured type");
+        
+        if (is_array()) {
+            return (*this)[path];
+        }
+        
+        return at(jtype::path(path, jtype::path::lookup_only()));
+    }
+    
+    inline void jtype::path::assign(const jtype &p) {
+        if (p.is_array()) {
+            for (auto && e : p) {
+                add(e.as<std::string>());
+            }
+        } else {
+            split(p.as<std::string>());
+        }
+    }
+    
+    inline jtype &jtype::at(const path &p) {
+        if (!is_structured())
+            throw type_error("at() requires structured type");
         
-        if (elems.size() == 0)
+        if (p.empty())
             return *this;
         
-        const int n = (int)elems.size();
+        const std::size_t n = p.size();
         
         jtype *e = this;
-        for (size_t i = 0; i < n-1; ++i) {
-            const std::string pe = elems[i].as<std::string>();
-            jtype &c = (*e)[pe];
+        for (std::size_t i = 0; i < n - 1; ++i) {
+            jtype &c = p._segments[i](*e);
             if (!c.is_object()) {
                 c = jtype::object();
             }
             e = &c;
         }
         
-        return (*e)[elems[n-1]];
+        return p._segments[n - 1](*e);
     }
     
-    
-    inline const jtype &jtype::at(const jtype &path) const {
+    inline const jtype &jtype::at(const path &p) const {
         if (!is_structured())
             throw type_error("at() requires structured type");
         
-        if (is_array()) {
-            return (*this)[path];
+        const jtype *e = this;
+        for (auto && segment : p._segments) {
+            const jtype &c = segment(*e);
+            if (c.is_undefined()) {
+                return c;
+            }
+            e = &c;
         }
         
-        jtype elems = path.is_array() ? path : jtype(path.as<std::string>()).split('.');
+        return *e;
+    }
+    
+    inline jtype &jtype::at(const pointer &p) {
+        if (p.empty())
+            return *this;
+        
+        if (!is_structured())
+            throw type_error("at() requires structured type");
+        
+        jtype *e = this;
+        for (auto && t : p._tokens) {
+            if (!e->is_structured()) {
+                *e = jtype::object();
+            }
+            
+            if (e->is_object()) {
+                e = &t.key(*e);
+                continue;
+            }
+            
+            array_t &a = e->_value.get<array_t>();
+            if (t.index == pointer::append_index) {
+                a.emplace_back();
+                e = &a.back();
+            } else if (t.index == pointer::no_index) {
+                throw type_error("at() pointer token is not an array index");
+            } else {
+                if (a.size() < t.index + 1) {
+                    a.resize(t.index + 1);
+                }
+                e = &a[t.index];
+            }
+        }
         
-        if (elems.size() == 0)
+        return *e;
+    }
+    
+    inline const jtype &jtype::at(const pointer &p) const {
+        if (p.empty())
             return *this;
         
-        const int n = (int)elems.size();
+        if (!is_structured())
+            throw type_error("at() requires structured type");
         
         const jtype *e = this;
-        for (size_t i = 0; i < n; ++i) {
-            const std::string pe = elems[i].as<std::string>();
-            const jtype &c = (*e)[pe];
-            if (c.is_undefined()) {
-                return c;
+        for (auto && t : p._tokens) {
+            if (e->is_array()) {
+                const array_t &a = e->_value.get<array_t>();
+                if (t.index == pointer::no_index) {
+                    throw type_error("at() pointer token is not an array index");
+                } else if (t.index >= a.size()) {
+                    return global_undefined();
+                }
+                e = &a[t.index];
+            } else {
+                const jtype &c = t.key(*e);
+                if (c.is_undefined()) {
+                    return c;
+                }
+                e = &c;
             }
-            e = &c;
         }
         
         return *e;
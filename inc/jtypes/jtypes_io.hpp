@@ -24,113 +24,547 @@
 
 #include "jtypes.hpp"
 
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
 namespace jtypes {
 
     using json = nlohmann::json;
 
     namespace details {
 
-        inline json to_json(const jtype &v, bool *should_discard = 0) {
-            if (should_discard) *should_discard = false;
-            
-            switch(v.type()) {
-                case jtype::vtype::array: {
-                    bool discard = false;
-                    json j = json::array();
-                    for (auto && vv : v) {
-                        json jj = to_json(vv, &discard);
-                        if (!discard) j.push_back(jj);
-                    }
-                    return j;
-                }
-                case jtype::vtype::boolean:
-                    return v.as<bool>();
-                case jtype::vtype::signed_number:
-                    return v.as<std::int64_t>();
-                case jtype::vtype::unsigned_number:
-                    return v.as<std::uint64_t>();
-                case jtype::vtype::real_number:
-                    return v.as<double>();
-                case jtype::vtype::string:
-                    return v.as<std::string>();
-                case jtype::vtype::object: {
-                    bool discard = false;
-                    json j = json::object();
-                    for (auto && k : v.keys()) {
-                        json jj = to_json(v[k], &discard);
-                        if (!discard) j[k.as<std::string>()] = jj;
-                    }
-                    return j;
+        inline json to_json(const jtype &v, bool *should_discard = 0);
+        
+        struct to_json_visitor {
+            bool *should_discard;
+            
+            json operator()(const jtype::undefined_t &v) const { *should_discard = true; return json(); }
+            json operator()(const jtype::null_t &v) const { return nullptr; }
+            json operator()(const bool &v) const { return v; }
+            json operator()(const std::int64_t &v) const { return v; }
+            json operator()(const std::uint64_t &v) const { return v; }
+            json operator()(const double &v) const { return v; }
+            json operator()(const std::string &v) const { return v; }
+            json operator()(const jtype::function_t &v) const { *should_discard = true; return json(); }
+            
+            json operator()(const jtype::array_t &v) const {
+                bool discard = false;
+                json j = json::array();
+                for (auto && vv : v) {
+                    json jj = to_json(vv, &discard);
+                    if (!discard) j.push_back(std::move(jj));
                 }
-                case jtype::vtype::function:
-                case jtype::vtype::undefined: {
-                    if (should_discard) *should_discard = true;
-                    return json();
+                return j;
+            }
+            
+            json operator()(const jtype::object_t &v) const {
+                bool discard = false;
+                json j = json::object();
+                for (auto && p : v) {
+                    json jj = to_json(p.second, &discard);
+                    if (!discard) j[key_string(p.first)] = std::move(jj);
                 }
-                case jtype::vtype::null: {
-                    return nullptr;
-                }                    
+                return j;
             }
-            throw type_error("to_json() unexpected type.");
+        };
+        
+        inline json to_json(const jtype &v, bool *should_discard) {
+            bool discard = false;
+            to_json_visitor visitor = {&discard};
+            json j = v.visit(visitor);
+            if (should_discard) *should_discard = discard;
+            return j;
         }
         
-        inline jtype from_json(const json &j) {
+        // Strings of a json that is being consumed are moved instead of copied.
+        inline std::string take_string(const json &j) { return j.get<std::string>(); }
+        inline std::string take_string(json &j) { return std::move(*j.get_ptr<json::string_t*>()); }
+        
+        // Consumed children are released right away, so that the json and the jtype
+        // document do not have to be held in memory completely at the same time.
+        inline void release(const json &j) {}
+        inline void release(json &j) { j = nullptr; }
+        
+        template<class Json>
+        jtype from_json_impl(Json &j) {
             switch (j.type()) {
                 case json::value_t::array: {
-                    jtype v = jtype::array_t();
+                    // Containers are filled before they become a jtype, this avoids property
+                    // lookups and leaves copy-on-write payloads shareable.
+                    jtype::array_t a;
+                    a.reserve(j.size());
                     for (auto iter = j.begin(); iter != j.end(); ++iter) {
-                        v.push_back(from_json(*iter));
+                        a.push_back(from_json_impl(*iter));
+                        release(*iter);
                     }
-                    return v;
+                    return jtype(std::move(a));
                 }
                 case json::value_t::boolean:
-                    return j.get<bool>();
+                    return j.template get<bool>();
                 case json::value_t::null:
                     return nullptr;
                 case json::value_t::number_float:
-                    return j.get<double>();
+                    return j.template get<double>();
                 case json::value_t::number_integer:
-                    return j.get<std::int64_t>();
+                    return j.template get<std::int64_t>();
                 case json::value_t::number_unsigned:
-                    return j.get<std::uint64_t>();
+                    return j.template get<std::uint64_t>();
                 case json::value_t::object: {
-                    jtype v = jtype::object_t();
+                    jtype::object_t o;
                     for (auto iter = j.begin(); iter != j.end(); ++iter) {
-                        v[iter.key()] = from_json(iter.value());
+                        o.emplace(iter.key(), from_json_impl(iter.value()));
+                        release(iter.value());
                     }
-                    return v;
+                    return jtype(std::move(o));
                 }
                 case json::value_t::string:
-                    return j.get<std::string>();
+                    return take_string(j);
                 case json::value_t::discarded:
                     return jtype();
             }
 
             throw type_error("from_json() unexpected type.");
         }
+        
+        /**
+            Parses JSON text directly into a jtype without building an intermediate json.
+         
+            Strings without escape sequences are copied from the input exactly once.
+            Numbers are typed like the json parser does: non-negative integers become
+            unsigned, negative integers signed and integers out of range real numbers.
+            Duplicate property names keep the last value. A leading UTF-8 byte order mark
+            is skipped, as the json parser does.
+        */
+        class reader {
+        public:
+            reader(const char *first, const char *last)
+            : _first(first), _p(first), _last(last) {
+            }
+            
+            jtype parse_document() {
+                if (_last - _p >= 3 && std::memcmp(_p, "\xEF\xBB\xBF", 3) == 0) {
+                    _p += 3;
+                }
+                skip_whitespace();
+                jtype v = parse_value();
+                skip_whitespace();
+                if (_p != _last) fail("expected end of input");
+                return v;
+            }
+            
+        private:
+            jtype parse_value() {
+                if (_p == _last) fail("unexpected end of input");
+                
+                switch (*_p) {
+                    case '{': return parse_object();
+                    case '[': return parse_array();
+                    case '"': return parse_string();
+                    case 't': expect("true"); return true;
+                    case 'f': expect("false"); return false;
+                    case 'n': expect("null"); return nullptr;
+                    default:
+                        if (*_p == '-' || is_digit(*_p)) return parse_number();
+                        fail("unexpected character");
+                }
+                return jtype();
+            }
+            
+            jtype parse_object() {
+                jtype::object_t o;
+                ++_p;
+                skip_whitespace();
+                if (consume('}')) return jtype(std::move(o));
+                
+                do {
+                    skip_whitespace();
+                    if (_p == _last || *_p != '"') fail("expected property name");
+                    std::string key = parse_string();
+                    skip_whitespace();
+                    if (!consume(':')) fail("expected ':'");
+                    skip_whitespace();
+                    jtype value = parse_value();
+                    details::find_or_insert(o, std::move(key)) = std::move(value);
+                    skip_whitespace();
+                } while (consume(','));
+                
+                if (!consume('}')) fail("expected ',' or '}'");
+                return jtype(std::move(o));
+            }
+            
+            jtype parse_array() {
+                jtype::array_t a;
+                ++_p;
+                skip_whitespace();
+                if (consume(']')) return jtype(std::move(a));
+                
+                do {
+                    skip_whitespace();
+                    a.push_back(parse_value());
+                    skip_whitespace();
+                } while (consume(','));
+                
+                if (!consume(']')) fail("expected ',' or ']'");
+                return jtype(std::move(a));
+            }
+            
+            std::string parse_string() {
+                ++_p;
+                const char *run = _p;
+                while (_p != _last && *_p != '"' && *_p != '\\' && static_cast<unsigned char>(*_p) >= 0x20) {
+                    ++_p;
+                }
+                std::string str(run, _p);
+                
+                while (_p != _last) {
+                    const char c = *_p++;
+                    if (c == '"') {
+                        return str;
+                    } else if (c == '\\') {
+                        parse_escape(str);
+                    } else if (static_cast<unsigned char>(c) < 0x20) {
+                        --_p;
+                        fail("control character in string");
+                    } else {
+                        str.push_back(c);
+                    }
+                }
+                fail("unterminated string");
+                return str;
+            }
+            
+            void parse_escape(std::string &str) {
+                if (_p == _last) fail("unterminated string");
+                switch (*_p++) {
+                    case '"': str.push_back('"'); break;
+                    case '\\': str.push_back('\\'); break;
+                    case '/': str.push_back('/'); break;
+                    case 'b': str.push_back('\b'); break;
+                    case 'f': str.push_back('\f'); break;
+                    case 'n': str.push_back('\n'); break;
+                    case 'r': str.push_back('\r'); break;
+                    case 't': str.push_back('\t'); break;
+                    case 'u': {
+                        std::uint32_t cp = parse_hex4();
+                        if (cp >= 0xD800 && cp <= 0xDBFF) {
+                            if (_last - _p < 2 || _p[0] != '\\' || _p[1] != 'u') fail("expected low surrogate");
+                            _p += 2;
+                            const std::uint32_t low = parse_hex4();
+                            if (low < 0xDC00 || low > 0xDFFF) fail("invalid low surrogate");
+                            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                            fail("unexpected low surrogate");
+                        }
+                        append_utf8(str, cp);
+                        break;
+                    }
+                    default:
+                        --_p;
+                        fail("invalid escape sequence");
+                }
+            }
+            
+            std::uint32_t parse_hex4() {
+                if (_last - _p < 4) fail("incomplete unicode escape");
+                std::uint32_t cp = 0;
+                for (int i = 0; i < 4; ++i, ++_p) {
+                    const char c = *_p;
+                    cp <<= 4;
+                    if (c >= '0' && c <= '9') cp |= std::uint32_t(c - '0');
+                    else if (c >= 'a' && c <= 'f') cp |= std::uint32_t(c - 'a' + 10);
+                    else if (c >= 'A' && c <= 'F') cp |= std::uint32_t(c - 'A' + 10);
+                    else fail("invalid unicode escape");
+                }
+                return cp;
+            }
+            
+            static void append_utf8(std::string &str, std::uint32_t cp) {
+                if (cp < 0x80) {
+                    str.push_back(char(cp));
+                } else if (cp < 0x800) {
+                    str.push_back(char(0xC0 | (cp >> 6)));
+                    str.push_back(char(0x80 | (cp & 0x3F)));
+                } else if (cp < 0x10000) {
+                    str.push_back(char(0xE0 | (cp >> 12)));
+                    str.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+                    str.push_back(char(0x80 | (cp & 0x3F)));
+                } else {
+                    str.push_back(char(0xF0 | (cp >> 18)));
+                    str.push_back(char(0x80 | ((cp >> 12) & 0x3F)));
+                    str.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+                    str.push_back(char(0x80 | (cp & 0x3F)));
+                }
+            }
+            
+            jtype parse_number() {
+                const char *start = _p;
+                const bool negative = consume('-');
+                
+                if (_p == _last || !is_digit(*_p)) fail("invalid number");
+                if (!consume('0')) {
+                    while (_p != _last && is_digit(*_p)) ++_p;
+                }
+                
+                bool integral = true;
+                if (consume('.')) {
+                    integral = false;
+                    if (_p == _last || !is_digit(*_p)) fail("invalid number");
+                    while (_p != _last && is_digit(*_p)) ++_p;
+                }
+                if (_p != _last && (*_p == 'e' || *_p == 'E')) {
+                    integral = false;
+                    ++_p;
+                    if (!consume('+')) consume('-');
+                    if (_p == _last || !is_digit(*_p)) fail("invalid number");
+                    while (_p != _last && is_digit(*_p)) ++_p;
+                }
+                
+                if (integral) {
+                    std::uint64_t u = 0;
+                    bool overflow = false;
+                    for (const char *d = start + (negative ? 1 : 0); d != _p; ++d) {
+                        const std::uint64_t digit = std::uint64_t(*d - '0');
+                        if (u > (std::numeric_limits<std::uint64_t>::max() - digit) / 10) {
+                            overflow = true;
+                            break;
+                        }
+                        u = u * 10 + digit;
+                    }
+                    
+                    if (!overflow && !negative) {
+                        return u;
+                    }
+                    if (!overflow && u <= std::uint64_t(std::numeric_limits<std::int64_t>::max()) + 1) {
+                        return u == 0 ? std::int64_t(0) : -std::int64_t(u - 1) - 1;
+                    }
+                }
+                
+                // Locale independent and works on the unterminated input buffer.
+                number_literal n;
+                read_number(start, _p, n);
+                return n.value;
+            }
+            
+            void expect(const char *literal) {
+                for (; *literal; ++literal, ++_p) {
+                    if (_p == _last || *_p != *literal) fail("invalid literal");
+                }
+            }
+            
+            bool consume(char c) {
+                if (_p != _last && *_p == c) {
+                    ++_p;
+                    return true;
+                }
+                return false;
+            }
+            
+            void skip_whitespace() {
+                while (_p != _last && (*_p == ' ' || *_p == '\t' || *_p == '\n' || *_p == '\r')) ++_p;
+            }
+            
+            static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+            
+            void fail(const char *what) const {
+                throw syntax_error(std::string("parse error at offset ") + std::to_string(_p - _first) + " - " + what);
+            }
+            
+            const char *_first;
+            const char *_p;
+            const char *_last;
+        };
+        
+        /**
+            Serializes a jtype directly to JSON text without building an intermediate json.
+         
+            The output matches json::dump(): properties are sorted by name, undefined and
+            function values are left out of containers, and a negative indent writes
+            everything on one line. Numbers are formatted like as<std::string>(), except
+            that NaN and infinities become null as in JSON.stringify().
+        */
+        class writer {
+        public:
+            writer(std::string &out, int indent)
+            : _out(out), _indent(indent), _depth(0) {
+            }
+            
+            void write_document(const jtype &v) {
+                if (is_discarded(v)) {
+                    _out += "null";
+                } else {
+                    v.visit(*this);
+                }
+            }
+            
+            void operator()(const jtype::undefined_t &v) { _out += "null"; }
+            void operator()(const jtype::null_t &v) { _out += "null"; }
+            void operator()(const bool &v) { _out += v ? "true" : "false"; }
+            void operator()(const std::string &v) { write_string(v); }
+            void operator()(const jtype::function_t &v) { _out += "null"; }
+            
+            template<class T>
+            void operator()(const T &v, meta::if_is_number_t<T> *unused=0) {
+                char buf[number_buffer_size];
+                if (is_finite(v)) {
+                    _out.append(buf, format_number(v, buf));
+                } else {
+                    _out += "null";
+                }
+            }
+            
+            void operator()(const jtype::array_t &v) {
+                _out += '[';
+                bool first = true;
+                for (auto && e : v) {
+                    if (is_discarded(e)) continue;
+                    begin_item(first);
+                    e.visit(*this);
+                }
+                end_container(first, ']');
+            }
+            
+            void operator()(const jtype::object_t &v) {
+                _out += '{';
+                bool first = true;
+                if (is_sorted(v)) {
+                    for (auto && p : v) {
+                        write_property(key_string(p.first), p.second, first);
+                    }
+                } else {
+                    std::vector<std::pair<const std::string*, const jtype*> > props;
+                    props.reserve(v.size());
+                    for (auto && p : v) {
+                        props.emplace_back(&key_string(p.first), &p.second);
+                    }
+                    std::sort(props.begin(), props.end(), [](const std::pair<const std::string*, const jtype*> &a, const std::pair<const std::string*, const jtype*> &b) {
+                        return *a.first < *b.first;
+                    });
+                    for (auto && p : props) {
+                        write_property(*p.first, *p.second, first);
+                    }
+                }
+                end_container(first, '}');
+            }
+            
+        private:
+            static bool is_discarded(const jtype &v) { return v.is_undefined() || v.is_function(); }
+            
+            static bool is_finite(double v) { return v - v == 0; }
+            
+            template<class T>
+            static bool is_finite(const T &v) { return true; }
+            
+            // Hashed and interned keys do not iterate in name order.
+            static bool is_sorted(const jtype::object_t &v) {
+                const std::string *prev = nullptr;
+                for (auto && p : v) {
+                    const std::string &k = key_string(p.first);
+                    if (prev && k < *prev) return false;
+                    prev = &k;
+                }
+                return true;
+            }
+            
+            void write_property(const std::string &key, const jtype &value, bool &first) {
+                if (is_discarded(value)) return;
+                begin_item(first);
+                write_string(key);
+                _out += ':';
+                if (_indent >= 0) _out += ' ';
+                value.visit(*this);
+            }
+            
+            void begin_item(bool &first) {
+                if (first) {
+                    ++_depth;
+                    if (_indent >= 0) _out += '\n';
+                    first = false;
+                } else {
+                    _out += ',';
+                    if (_indent >= 0) _out += '\n';
+                }
+                if (_indent > 0) _out.append(std::size_t(_depth * _indent), ' ');
+            }
+            
+            void end_container(bool empty, char c) {
+                if (!empty) {
+                    --_depth;
+                    if (_indent >= 0) _out += '\n';
+                    if (_indent > 0) _out.append(std::size_t(_depth * _indent), ' ');
+                }
+                _out += c;
+            }
+            
+            void write_string(const std::string &s) {
+                std::string &out = _out;
+                out += '"';
+                escape_json_string(s.data(), s.size(), [&out](const char *data, std::size_t length) { out.append(data, length); });
+                out += '"';
+            }
+            
+            std::string &_out;
+            int _indent;
+            int _depth;
+        };
+        
+        inline jtype from_json(const json &j) {
+            return from_json_impl(j);
+        }
+        
+        // Converts j by moving its strings, leaves j null.
+        inline jtype from_json(json &&j) {
+            jtype v = from_json_impl(j);
+            release(j);
+            return v;
+        }
     }
     
     inline std::string to_json(const jtype &v) {
-        return details::to_json(v).dump();
+        std::string s;
+        details::writer(s, -1).write_document(v);
+        return s;
     }
     
     inline std::string to_json(const jtype &v, int intend) {
-        return details::to_json(v).dump(intend);
+        std::string s;
+        details::writer(s, intend).write_document(v);
+        return s;
     }
     
     inline jtype from_json(const std::string &str) {
         try {
             json j = json::parse(str);
-            return details::from_json(j);
+            return details::from_json(std::move(j));
         } catch (std::exception &e) {
             throw syntax_error(e.what());
         }
     }
     
+    /**
+        Parses a moved-in input buffer directly into a jtype. 
+     
+        No intermediate json document is built and the buffer is released once parsed,
+        which roughly halves peak memory for large inputs.
+    */
+    inline jtype from_json(std::string &&str) {
+        jtype v = details::reader(str.data(), str.data() + str.size()).parse_document();
+        std::string().swap(str);
+        return v;
+    }
+    
+    /**
+        Parses size bytes at data directly into a jtype, for example a memory mapped file.
+        The data does not need to be null terminated.
+    */
+    inline jtype from_json(const char *data, std::size_t size) {
+        return details::reader(data, data + size).parse_document();
+    }
+    
     inline jtype from_json(std::istream &is) {
         try {
             json j = json::parse(is);
-            return details::from_json(j);
+            return details::from_json(std::move(j));
         } catch (std::exception &e) {
             throw syntax_error(e.what());
         }
@@ -138,7 +572,9 @@ namespace jtypes {
     
     inline std::ostream &operator<<(std::ostream &os, const jtype &v) {
         // use std::setw to format with intendation.
-        os << details::to_json(v);
+        const int intend = os.width() > 0 ? int(os.width()) : -1;
+        os.width(0);
+        os << to_json(v, intend);
         return os;
     }
     
@@ -0,0 +1,254 @@
+/**
+    This file is part of jtypes.
+
+    Copyright(C) 2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of MIT license. See the LICENSE file for details.
+*/
+
+#ifndef JTYPES_ROPE_H
+#define JTYPES_ROPE_H
+
+#include "jtypes.hpp"
+
+#include <ostream>
+#include <cassert>
+
+namespace jtypes {
+
+    namespace details {
+
+        /**
+            Immutable node of a rope. Leaves refer to a range of a shared string, inner
+            nodes concatenate two subtrees whose depths differ by at most one.
+        */
+        struct rope_node {
+            std::shared_ptr<const std::string> text;
+            std::size_t offset;
+            std::shared_ptr<const rope_node> left, right;
+            std::size_t length;
+            std::size_t depth;
+
+            bool is_leaf() const { return text != nullptr; }
+        };
+
+        using rope_ptr = std::shared_ptr<const rope_node>;
+
+        // Leaves up to this size are merged on concatenation.
+        const std::size_t rope_leaf_size = 256;
+
+        inline rope_ptr rope_leaf(std::shared_ptr<const std::string> text, std::size_t offset, std::size_t length) {
+            if (length == 0) return rope_ptr();
+            return std::make_shared<rope_node>(rope_node{std::move(text), offset, rope_ptr(), rope_ptr(), length, 0});
+        }
+
+        inline rope_ptr rope_inner(rope_ptr l, rope_ptr r) {
+            const std::size_t length = l->length + r->length;
+            const std::size_t depth = 1 + std::max(l->depth, r->depth);
+            return std::make_shared<rope_node>(rope_node{nullptr, 0, std::move(l), std::move(r), length, depth});
+        }
+
+        // Restores the depth invariant for subtrees whose depths differ by at most two.
+        inline rope_ptr rope_balance(const rope_ptr &l, const rope_ptr &r) {
+            if (l->depth > r->depth + 1) {
+                if (l->left->depth >= l->right->depth) {
+                    return rope_inner(l->left, rope_inner(l->right, r));
+                }
+                return rope_inner(rope_inner(l->left, l->right->left), rope_inner(l->right->right, r));
+            }
+            if (r->depth > l->depth + 1) {
+                if (r->right->depth >= r->left->depth) {
+                    return rope_inner(rope_inner(l, r->left), r->right);
+                }
+                return rope_inner(rope_inner(l, r->left->left), rope_inner(r->left->right, r->right));
+            }
+            return rope_inner(l, r);
+        }
+
+        inline rope_ptr rope_join(const rope_ptr &l, const rope_ptr &r) {
+            if (!l) return r;
+            if (!r) return l;
+
+            if (l->is_leaf() && r->is_leaf() && l->length + r->length <= rope_leaf_size) {
+                auto s = std::make_shared<std::string>();
+                s->reserve(l->length + r->length);
+                s->append(*l->text, l->offset, l->length);
+                s->append(*r->text, r->offset, r->length);
+                const std::size_t length = s->size();
+                return rope_leaf(std::move(s), 0, length);
+            }
+
+            if (l->depth > r->depth + 1) {
+                return rope_balance(l->left, rope_join(l->right, r));
+            }
+            if (r->depth > l->depth + 1) {
+                return rope_balance(rope_join(l, r->left), r->right);
+            }
+            return rope_inner(l, r);
+        }
+
+        inline rope_ptr rope_slice(const rope_ptr &n, std::size_t pos, std::size_t count) {
+            if (!n || count == 0) return rope_ptr();
+            if (pos == 0 && count == n->length) return n;
+            if (n->is_leaf()) return rope_leaf(n->text, n->offset + pos, count);
+
+            const std::size_t split = n->left->length;
+            if (pos + count <= split) return rope_slice(n->left, pos, count);
+            if (pos >= split) return rope_slice(n->right, pos - split, count);
+            return rope_join(rope_slice(n->left, pos, split - pos), rope_slice(n->right, 0, pos + count - split));
+        }
+
+        template<class F>
+        void rope_chunks(const rope_ptr &n, F &f) {
+            if (!n) return;
+            if (n->is_leaf()) {
+                f(n->text->data() + n->offset, n->length);
+            } else {
+                rope_chunks(n->left, f);
+                rope_chunks(n->right, f);
+            }
+        }
+    }
+
+    /**
+        Immutable string with cheap concatenation and substring extraction.
+
+        A rope is a balanced tree of shared string fragments. Concatenation and substr()
+        take logarithmic time and share the fragments of their operands. The characters
+        are only copied into a contiguous string by str(), or by constructing a jtype
+        from the rope. Fragments are kept alive as a whole, a short substring of a long
+        rope holds on to the memory of the fragments it refers to.
+    */
+    class rope {
+    public:
+        using size_type = std::size_t;
+
+        static const size_type npos = size_type(-1);
+
+        rope() {}
+
+        rope(std::string s) {
+            const size_type length = s.size();
+            _root = details::rope_leaf(std::make_shared<const std::string>(std::move(s)), 0, length);
+        }
+
+        rope(const char *s)
+        : rope(std::string(s)) {
+        }
+
+        // Coerces v to string.
+        explicit rope(const jtype &v)
+        : rope(v.as<std::string>()) {
+        }
+
+        size_type size() const { return _root ? _root->length : 0; }
+        bool empty() const { return size() == 0; }
+
+        // Like std::string, idx == size() returns '\0'.
+        char operator[](size_type idx) const {
+            assert(idx <= size());
+            if (idx == size()) return '\0';
+            
+            const details::rope_node *n = _root.get();
+            while (!n->is_leaf()) {
+                if (idx < n->left->length) {
+                    n = n->left.get();
+                } else {
+                    idx -= n->left->length;
+                    n = n->right.get();
+                }
+            }
+            return (*n->text)[n->offset + idx];
+        }
+
+        char at(size_type idx) const {
+            if (idx >= size()) {
+                throw range_error("rope index out of range");
+            }
+            return (*this)[idx];
+        }
+
+        rope substr(size_type pos, size_type count = npos) const {
+            if (pos > size()) {
+                throw range_error("rope position out of range");
+            }
+            return rope(details::rope_slice(_root, pos, std::min(count, size() - pos)));
+        }
+
+        // Calls f(const char *data, size_type length) for each fragment in order.
+        template<class F>
+        void for_each_chunk(F f) const {
+            details::rope_chunks(_root, f);
+        }
+
+        std::string str() const {
+            std::string s;
+            s.reserve(size());
+            for_each_chunk([&s](const char *data, size_type length) { s.append(data, length); });
+            return s;
+        }
+
+        explicit operator jtype() const { return jtype(str()); }
+
+        rope &operator+=(const rope &rhs) {
+            _root = details::rope_join(_root, rhs._root);
+            return *this;
+        }
+
+        friend rope operator+(const rope &lhs, const rope &rhs) {
+            return rope(details::rope_join(lhs._root, rhs._root));
+        }
+
+        friend bool operator==(const rope &lhs, const rope &rhs) {
+            return lhs.size() == rhs.size() && lhs.compare(rhs) == 0;
+        }
+
+        friend bool operator!=(const rope &lhs, const rope &rhs) { return !(lhs == rhs); }
+        friend bool operator<(const rope &lhs, const rope &rhs) { return lhs.compare(rhs) < 0; }
+
+        friend std::ostream &operator<<(std::ostream &os, const rope &r) {
+            r.for_each_chunk([&os](const char *data, size_type length) { os.write(data, length); });
+            return os;
+        }
+
+    private:
+        explicit rope(details::rope_ptr root)
+        : _root(std::move(root)) {
+        }
+
+        int compare(const rope &rhs) const {
+            std::vector<std::pair<const char*, size_type> > a, b;
+            for_each_chunk([&a](const char *data, size_type length) { a.emplace_back(data, length); });
+            rhs.for_each_chunk([&b](const char *data, size_type length) { b.emplace_back(data, length); });
+
+            size_type i = 0, j = 0, oi = 0, oj = 0;
+            while (i < a.size() && j < b.size()) {
+                const size_type n = std::min(a[i].second - oi, b[j].second - oj);
+                const int c = std::char_traits<char>::compare(a[i].first + oi, b[j].first + oj, n);
+                if (c != 0) return c;
+                oi += n;
+                oj += n;
+                if (oi == a[i].second) { ++i; oi = 0; }
+                if (oj == b[j].second) { ++j; oj = 0; }
+            }
+            return size() < rhs.size() ? -1 : (size() > rhs.size() ? 1 : 0);
+        }
+
+        details::rope_ptr _root;
+    };
+
+    /**
+        Writes r as quoted JSON string without flattening it.
+    */
+    inline std::ostream &write_json(std::ostream &os, const rope &r) {
+        os << '"';
+        auto write = [&os](const char *data, std::size_t length) { os.write(data, std::streamsize(length)); };
+        r.for_each_chunk([&write](const char *data, std::size_t length) { details::escape_json_string(data, length, write); });
+        os << '"';
+        return os;
+    }
+}
+
+#endif
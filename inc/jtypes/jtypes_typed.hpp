@@ -0,0 +1,175 @@
+/**
+    This file is part of jtypes.
+
+    Copyright(C) 2016 Christoph Heindl
+    All rights reserved.
+
+    This software may be modified and distributed under the terms
+    of MIT license. See the LICENSE file for details.
+*/
+
+#ifndef JTYPES_TYPED_H
+#define JTYPES_TYPED_H
+
+#include "jtypes.hpp"
+
+#include <cstring>
+
+namespace jtypes {
+
+    /**
+        Fixed length raw binary buffer, mimics ECMAScript ArrayBuffer.
+
+        Copies refer to the same bytes. Use slice() for an independent copy.
+    */
+    class array_buffer {
+    public:
+        explicit array_buffer(std::size_t byte_length = 0)
+        : _bytes(std::make_shared<std::vector<std::uint8_t> >(byte_length)) {
+        }
+
+        std::size_t byte_length() const { return _bytes->size(); }
+
+        std::uint8_t *data() { return _bytes->data(); }
+        const std::uint8_t *data() const { return _bytes->data(); }
+
+        array_buffer slice(std::size_t begin, std::size_t end) const {
+            end = std::min(end, byte_length());
+            begin = std::min(begin, end);
+
+            array_buffer b(end - begin);
+            if (end > begin) {
+                std::memcpy(b.data(), data() + begin, end - begin);
+            }
+            return b;
+        }
+
+        friend bool operator==(const array_buffer &lhs, const array_buffer &rhs) { return lhs._bytes == rhs._bytes; }
+        friend bool operator!=(const array_buffer &lhs, const array_buffer &rhs) { return lhs._bytes != rhs._bytes; }
+
+    private:
+        std::shared_ptr<std::vector<std::uint8_t> > _bytes;
+    };
+
+    /**
+        View of an array_buffer as contiguous numbers of type T, mimics ECMAScript typed arrays.
+
+        Elements are stored unboxed, data() gives direct access for numeric code. Views that
+        share a buffer see each others modifications. Convert to a jtype array by
+        jtype::array(v.begin(), v.end()) and back by constructing a typed_array from a jtype.
+    */
+    template<typename T>
+    class typed_array {
+        static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value, "typed_array requires numeric element type");
+
+    public:
+        using value_type = T;
+        using size_type = std::size_t;
+        using iterator = T*;
+        using const_iterator = const T*;
+
+        static const size_type bytes_per_element = sizeof(T);
+
+        explicit typed_array(size_type length = 0)
+        : _buffer(length * sizeof(T)), _offset(0), _length(length) {
+        }
+
+        typed_array(std::initializer_list<T> init)
+        : typed_array(init.size()) {
+            std::copy(init.begin(), init.end(), begin());
+        }
+
+        template<class Iter, class = typename std::enable_if<!std::is_arithmetic<Iter>::value>::type>
+        typed_array(Iter first, Iter last)
+        : typed_array(size_type(std::distance(first, last))) {
+            std::copy(first, last, begin());
+        }
+
+        explicit typed_array(const array_buffer &buffer, size_type byte_offset = 0)
+        : _buffer(buffer), _offset(byte_offset), _length(0) {
+            if (byte_offset > buffer.byte_length() || (buffer.byte_length() - byte_offset) % sizeof(T) != 0) {
+                throw range_error("typed_array buffer length minus byte offset must be a multiple of the element size");
+            }
+            _length = (buffer.byte_length() - byte_offset) / sizeof(T);
+            check_alignment();
+        }
+
+        typed_array(const array_buffer &buffer, size_type byte_offset, size_type length)
+        : _buffer(buffer), _offset(byte_offset), _length(length) {
+            if (byte_offset > buffer.byte_length() || length > (buffer.byte_length() - byte_offset) / sizeof(T)) {
+                throw range_error("typed_array view exceeds buffer");
+            }
+            check_alignment();
+        }
+
+        // Copies the elements of a jtype array, coercing each to T.
+        explicit typed_array(const jtype &v)
+        : typed_array(v.is_array() ? v.size().as<size_type>() : 0) {
+            if (!v.is_array()) {
+                throw type_error("typed_array requires array type");
+            }
+
+            T *p = data();
+            for (auto && e : v) {
+                *p++ = e.as<T>();
+            }
+        }
+
+        T *data() { return reinterpret_cast<T*>(_buffer.data() + _offset); }
+        const T *data() const { return reinterpret_cast<const T*>(_buffer.data() + _offset); }
+
+        size_type size() const { return _length; }
+        size_type byte_offset() const { return _offset; }
+        size_type byte_length() const { return _length * sizeof(T); }
+
+        const array_buffer &buffer() const { return _buffer; }
+
+        T &operator[](size_type idx) { return data()[idx]; }
+        const T &operator[](size_type idx) const { return data()[idx]; }
+
+        iterator begin() { return data(); }
+        iterator end() { return data() + _length; }
+        const_iterator begin() const { return data(); }
+        const_iterator end() const { return data() + _length; }
+
+        // View of the elements [begin, end), shares the buffer.
+        typed_array subarray(size_type begin, size_type end) const {
+            end = std::min(end, _length);
+            begin = std::min(begin, end);
+            return typed_array(_buffer, _offset + begin * sizeof(T), end - begin);
+        }
+
+        friend bool operator==(const typed_array &lhs, const typed_array &rhs) {
+            return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+        }
+
+        friend bool operator!=(const typed_array &lhs, const typed_array &rhs) { return !(lhs == rhs); }
+
+    private:
+        void check_alignment() const {
+            if (_offset % sizeof(T) != 0) {
+                throw range_error("typed_array byte offset must be a multiple of the element size");
+            }
+        }
+
+        array_buffer _buffer;
+        size_type _offset;
+        size_type _length;
+    };
+
+    template<typename T>
+    const typename typed_array<T>::size_type typed_array<T>::bytes_per_element;
+
+    using int8_array = typed_array<std::int8_t>;
+    using uint8_array = typed_array<std::uint8_t>;
+    using int16_array = typed_array<std::int16_t>;
+    using uint16_array = typed_array<std::uint16_t>;
+    using int32_array = typed_array<std::int32_t>;
+    using uint32_array = typed_array<std::uint32_t>;
+    using int64_array = typed_array<std::int64_t>;
+    using uint64_array = typed_array<std::uint64_t>;
+    using float32_array = typed_array<float>;
+    using float64_array = typed_array<double>;
+}
+
+#endif
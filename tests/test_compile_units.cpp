@@ -9,9 +9,12 @@ of MIT license. See the LICENSE file for details.
 */
 
 #include "catch.hpp"
+#include "test_traits.hpp"
 
 #include <jtypes/jtypes.hpp>
 #include <jtypes/jtypes_io.hpp>
+#include <jtypes/jtypes_typed.hpp>
+#include <jtypes/jtypes_rope.hpp>
 
 TEST_CASE("jtypes")
 {
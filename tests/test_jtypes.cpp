@@ -10,9 +10,17 @@ of MIT license. See the LICENSE file for details.
 
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
+#include "test_traits.hpp"
 
 #include <jtypes/jtypes.hpp>
 #include <jtypes/jtypes_io.hpp>
+#include <jtypes/jtypes_typed.hpp>
+#include <jtypes/jtypes_rope.hpp>
+
+#include <clocale>
+#include <cstring>
+#include <limits>
+#include <random>
 
 TEST_CASE("jtypes can be initialized from simple types")
 {
@@ -419,6 +427,30 @@ TEST_CASE("jtypes should handle coercion to integral types")
     REQUIRE(jtype("5").as<long>() == 5);
     REQUIRE(jtype("5.5").as<char>() == (char)5);
     
+    // Strings are read by ECMAScript ToNumber() rules
+    REQUIRE(jtype(" 42\n").as<int>() == 42);
+    REQUIRE(jtype("").as<int>() == 0);
+    REQUIRE(jtype("0x1F").as<int>() == 31);
+    REQUIRE(jtype("0b101").as<unsigned>() == 5);
+    REQUIRE(jtype("1e3").as<int>() == 1000);
+    REQUIRE(jtype("-5.9").as<int>() == -5);
+    REQUIRE(jtype("18446744073709551615").as<std::uint64_t>() == std::numeric_limits<std::uint64_t>::max());
+    REQUIRE(jtype("-9223372036854775808").as<std::int64_t>() == std::numeric_limits<std::int64_t>::min());
+    REQUIRE_THROWS_AS(jtype("12abc").as<int>(), jtypes::type_error);
+    REQUIRE_THROWS_AS(jtype("-0x10").as<int>(), jtypes::type_error);
+    REQUIRE_THROWS_AS(jtype("300").as<std::uint8_t>(), jtypes::type_error);
+    REQUIRE_THROWS_AS(jtype("-1").as<unsigned>(), jtypes::type_error);
+    REQUIRE_THROWS_AS(jtype("Infinity").as<int>(), jtypes::type_error);
+    
+    jtypes::coerce_error error;
+    REQUIRE(jtype("7").try_as<int>(error).value() == 7);
+    REQUIRE(error == jtypes::coerce_error::none);
+    REQUIRE(!jtype("7 apples").try_as<int>(error));
+    REQUIRE(error == jtypes::coerce_error::invalid_number);
+    REQUIRE(!jtype("9223372036854775808").try_as<std::int64_t>(error));
+    REQUIRE(error == jtypes::coerce_error::out_of_range);
+    REQUIRE(!jtype(jtype::object()).try_as<int>(error));
+    REQUIRE(error == jtypes::coerce_error::invalid_type);
 }
 
 TEST_CASE("jtypes should handle coercion to floating point types")
@@ -440,6 +472,16 @@ TEST_CASE("jtypes should handle coercion to floating point types")
     
     REQUIRE(jtype("5").as<double>() == 5.0);
     REQUIRE(jtype("-5.5").as<double>() == -5.5);
+    
+    REQUIRE(jtype(".5").as<double>() == 0.5);
+    REQUIRE(jtype("+1.5e-3").as<double>() == 0.0015);
+    REQUIRE(jtype("0.30000000000000004").as<double>() == 0.1 + 0.2);
+    REQUIRE(jtype("9007199254740993").as<double>() == 9007199254740992.0);
+    REQUIRE(jtype("-Infinity").as<double>() == -std::numeric_limits<double>::infinity());
+    REQUIRE(jtype("1e400").as<double>() == std::numeric_limits<double>::infinity());
+    REQUIRE_THROWS_AS(jtype("inf").as<double>(), jtypes::type_error);
+    REQUIRE_THROWS_AS(jtype("1.5.2").as<double>(), jtypes::type_error);
+    REQUIRE_THROWS_AS(jtype("1e").as<double>(), jtypes::type_error);
 }
 
 TEST_CASE("jtypes should handle coercion to string")
@@ -459,6 +501,60 @@ TEST_CASE("jtypes should handle coercion to string")
     using sig = int(void);
     REQUIRE(jtype(jtype::function<sig>([]() {return -1;})).as<std::string>() == "function");
     
+    // Nested arrays are flattened into one comma separated string
+    jtype nested = jtype::array({1, jtype::array({2.5, jtype::array({"x", nullptr})}), jtype::array(), true});
+    REQUIRE(nested.as<std::string>() == "1,2.5,x,null,,true");
+    
+    std::string out = "values: ";
+    jtypes::append_string(nested, out);
+    REQUIRE(out == "values: 1,2.5,x,null,,true");
+    
+    out.clear();
+    jtypes::append_string(jtype(-2), out);
+    jtypes::append_string(jtype("!"), out);
+    REQUIRE(out == "-2!");
+}
+
+TEST_CASE("jtypes should format numbers like ECMAScript")
+{
+    using jtypes::jtype;
+    
+    REQUIRE(jtype(2.0).as<std::string>() == "2");
+    REQUIRE(jtype(-1.5).as<std::string>() == "-1.5");
+    REQUIRE(jtype(0.1).as<std::string>() == "0.1");
+    REQUIRE(jtype(0.1 + 0.2).as<std::string>() == "0.30000000000000004");
+    REQUIRE(jtype(-0.0).as<std::string>() == "0");
+    REQUIRE(jtype(1e20).as<std::string>() == "100000000000000000000");
+    REQUIRE(jtype(1e21).as<std::string>() == "1e+21");
+    REQUIRE(jtype(1e23).as<std::string>() == "1e+23");
+    REQUIRE(jtype(0.000001).as<std::string>() == "0.000001");
+    REQUIRE(jtype(1e-7).as<std::string>() == "1e-7");
+    REQUIRE(jtype(123e-20).as<std::string>() == "1.23e-18");
+    REQUIRE(jtype(5e-324).as<std::string>() == "5e-324");
+    REQUIRE(jtype(1.7976931348623157e308).as<std::string>() == "1.7976931348623157e+308");
+    REQUIRE(jtype(std::numeric_limits<double>::quiet_NaN()).as<std::string>() == "NaN");
+    REQUIRE(jtype(-std::numeric_limits<double>::infinity()).as<std::string>() == "-Infinity");
+    
+    REQUIRE(jtype(std::numeric_limits<std::int64_t>::min()).as<std::string>() == "-9223372036854775808");
+    REQUIRE(jtype(std::numeric_limits<std::uint64_t>::max()).as<std::string>() == "18446744073709551615");
+    REQUIRE(jtype(0).as<std::string>() == "0");
+    
+    // Shortest digits that round-trip
+    std::mt19937_64 rng(7);
+    int mismatches = 0;
+    for (int i = 0; i < 10000; ++i) {
+        const std::uint64_t bits = rng() & 0x7FEFFFFFFFFFFFFFull;
+        double v;
+        std::memcpy(&v, &bits, sizeof(v));
+        
+        const std::string s = jtype(v).as<std::string>();
+        if (std::strtod(s.c_str(), nullptr) != v) ++mismatches;
+    }
+    REQUIRE(mismatches == 0);
+    
+    // JSON output shares the formatter, non-finite numbers become null
+    REQUIRE(jtypes::to_json(jtype::array({0.1 + 0.2, 1e21, std::numeric_limits<double>::infinity()})) == "[0.30000000000000004,1e+21,null]");
+    REQUIRE(jtypes::from_json(jtypes::to_json(jtype(0.1 + 0.2))) == jtype(0.1 + 0.2));
 }
 
 TEST_CASE("jtypes key and values should be iterable")
@@ -539,6 +635,108 @@ TEST_CASE("jtypes support at for nested object creation")
     REQUIRE(y.size() == 6);
 }
 
+TEST_CASE("jtypes should support compiled paths")
+{
+    using jtypes::jtype;
+    
+    const jtype::path p("first..number.");
+    REQUIRE(p.size() == 2);
+    REQUIRE(jtype::path().empty());
+    REQUIRE(jtype::path(jtype::array({"a", 1})).size() == 2);
+    
+    jtype x = jtype::object();
+    x.at(p) = 3;
+    x.at(jtype::path({"dotted.name", "leaf"})) = "x";
+    REQUIRE(x["first"]["number"] == 3);
+    REQUIRE(x["dotted.name"]["leaf"] == "x");
+    
+    // Non-object intermediates are replaced by objects when writing.
+    x.at(jtype::path("first.number.deep")) = true;
+    REQUIRE(x["first"]["number"]["deep"] == true);
+    
+    const jtype &cx = x;
+    int found = 0;
+    for (int i = 0; i < 100; ++i) {
+        found += cx.at(jtype::path("first.number.deep")) == true ? 1 : 0;
+    }
+    REQUIRE(found == 100);
+    REQUIRE(cx.at(jtype::path("first.missing.deep")).is_undefined());
+    REQUIRE(&cx.at(jtype::path()) == &cx);
+    
+    jtype other = jtype::object({{"first", jtype::object({{"number", 7}})}});
+    REQUIRE(static_cast<const jtype&>(other).at(p) == 7);
+    REQUIRE_THROWS_AS(jtype(1).at(p), jtypes::type_error);
+    REQUIRE_THROWS_AS(static_cast<const jtype&>(other).at(jtype::path("first.number.x")), jtypes::type_error);
+    
+    // Paths given to at() as jtype do not intern their names unless a property is created.
+    const std::size_t atoms = jtypes::atom_table::global().size();
+    for (int i = 0; i < 100; ++i) {
+        REQUIRE(cx.at("first.unused_" + std::to_string(i)).is_undefined());
+    }
+    REQUIRE(cx.at("first.number.deep") == true);
+    REQUIRE(jtypes::atom_table::global().size() == atoms);
+    x.at("first.created") = 1;
+    REQUIRE(cx["first"]["created"] == 1);
+}
+
+TEST_CASE("jtypes should support JSON pointers")
+{
+    using jtypes::jtype;
+    
+    // Example from RFC 6901
+    const jtype doc = jtypes::from_json(R"({
+        "foo": ["bar", "baz"], "": 0, "a/b": 1, "c%d": 2, "e^f": 3, "g|h": 4,
+        "i\\j": 5, "k\"l": 6, " ": 7, "m~n": 8})");
+    
+    REQUIRE(&doc.at(jtype::pointer("")) == &doc);
+    REQUIRE(doc.at(jtype::pointer("/foo")) == jtype::array({"bar", "baz"}));
+    REQUIRE(doc.at(jtype::pointer("/foo/0")) == "bar");
+    REQUIRE(doc.at(jtype::pointer("/")) == 0);
+    REQUIRE(doc.at(jtype::pointer("/a~1b")) == 1);
+    REQUIRE(doc.at(jtype::pointer("/c%d")) == 2);
+    REQUIRE(doc.at(jtype::pointer("/e^f")) == 3);
+    REQUIRE(doc.at(jtype::pointer("/g|h")) == 4);
+    REQUIRE(doc.at(jtype::pointer("/i\\j")) == 5);
+    REQUIRE(doc.at(jtype::pointer("/k\"l")) == 6);
+    REQUIRE(doc.at(jtype::pointer("/ ")) == 7);
+    REQUIRE(doc.at(jtype::pointer("/m~0n")) == 8);
+    
+    REQUIRE(doc.at(jtype::pointer("/foo/2")).is_undefined());
+    REQUIRE(doc.at(jtype::pointer("/foo/-")).is_undefined());
+    REQUIRE(doc.at(jtype::pointer("/missing/x")).is_undefined());
+    REQUIRE_THROWS_AS(doc.at(jtype::pointer("/foo/01")), jtypes::type_error);
+    REQUIRE_THROWS_AS(doc.at(jtype::pointer("/foo/x")), jtypes::type_error);
+    REQUIRE_THROWS_AS(jtype::pointer("foo"), jtypes::syntax_error);
+    REQUIRE_THROWS_AS(jtype::pointer("/a~2"), jtypes::syntax_error);
+    REQUIRE(jtype::pointer("/a~1b/m~0n/0").to_string() == "/a~1b/m~0n/0");
+    
+    // Missed lookups do not intern tokens.
+    const std::size_t atoms = jtypes::atom_table::global().size();
+    for (int i = 0; i < 100; ++i) {
+        REQUIRE(doc.at(jtype::pointer("/unused_" + std::to_string(i) + "/x")).is_undefined());
+    }
+    REQUIRE(jtypes::atom_table::global().size() == atoms);
+    
+    // Properties and elements are created when writing.
+    jtype x = jtype::object();
+    const jtype::pointer p("/list/-");
+    x.at(jtype::pointer("/list")) = jtype::array();
+    x.at(p) = 1;
+    x.at(p) = 2;
+    x.at(jtype::pointer("/list/3")) = 4;
+    x.at(jtype::pointer("/a.b/c")) = true;
+    x.at(jtype::pointer("/list/0/name")) = "first";
+    
+    REQUIRE(x["list"].size() == 4);
+    REQUIRE(x["list"][0]["name"] == "first");
+    REQUIRE(x["list"][1] == 2);
+    REQUIRE(x["list"][2].is_undefined());
+    REQUIRE(x["list"][3] == 4);
+    REQUIRE(x["a.b"]["c"] == true);
+    REQUIRE_THROWS_AS(x.at(jtype::pointer("/list/x")), jtypes::type_error);
+    REQUIRE_THROWS_AS(jtype(1).at(p), jtypes::type_error);
+}
+
 TEST_CASE("jtypes support clearing of structured elements") {
     
     using jtypes::jtype;
@@ -594,6 +792,516 @@ TEST_CASE("jtypes should allow on the array creation")
     
 }
 
+TEST_CASE("jtypes should support move semantics")
+{
+    using jtypes::jtype;
+    
+    static_assert(std::is_nothrow_move_constructible<jtype>::value, "jtype should be nothrow move constructible");
+    static_assert(std::is_nothrow_move_assignable<jtype>::value, "jtype should be nothrow move assignable");
+    
+    jtype x = jtype::array({1, 2, 3});
+    jtype y = std::move(x);
+    REQUIRE(y == jtype::array({1, 2, 3}));
+    
+    x = std::move(y);
+    REQUIRE(x == jtype::array({1, 2, 3}));
+    
+    // Moving from a child into its parent
+    x = jtype::object({{"a", jtype::array({"b", "c"})}});
+    x = std::move(x["a"]);
+    REQUIRE(x == jtype::array({"b", "c"}));
+    
+    jtype s = "hello world";
+    x.push_back(std::move(s));
+    REQUIRE(x[2] == "hello world");
+    
+    jtype &e = x.emplace_back(jtype::object());
+    e["a"] = 1;
+    REQUIRE(x[3] == jtype::object({{"a", 1}}));
+    REQUIRE(x.emplace_back().is_undefined());
+    REQUIRE(x.size() == 5);
+    
+    jtype o = jtype::object();
+    jtype k = "key";
+    o[std::move(k)] = 3;
+    o[jtype("key")] = 4;
+    REQUIRE(o == jtype::object({{"key", 4}}));
+    
+    jtype n = 1;
+    REQUIRE_THROWS_AS(n.emplace_back(1), jtypes::type_error);
+}
+
+TEST_CASE("jtypes copies should be independent")
+{
+    using jtypes::jtype;
+    
+    jtype a = jtype::object({{"list", jtype::array({1, 2, 3})}, {"name", "a"}});
+    const jtype &ca = a;
+    
+    // References obtained before a copy must not reach into the copy.
+    jtype &list = a["list"];
+    jtype b = a;
+    list.push_back(4);
+    a["name"] = "changed";
+    REQUIRE(b["list"].size() == 3);
+    REQUIRE(b["name"] == "a");
+    
+    jtype c = b;
+    const jtype &cc = c;
+    const jtype &cb = b;
+    c["list"][0] = 10;
+    REQUIRE(cc["list"][0] == 10);
+    REQUIRE(cb["list"][0] == 1);
+    REQUIRE(ca["list"][0] == 1);
+    
+    jtype d = c;
+    d.clear();
+    REQUIRE(d.size() == 0);
+    REQUIRE(c.size() == 2);
+    
+    jtype e = c;
+    e.merge_from(jtype::object({{"extra", true}}));
+    REQUIRE(e.size() == 3);
+    REQUIRE(c.size() == 2);
+    
+    // Const references obtained before a copy must keep referring to the original.
+    jtype f = jtype::object({{"x", jtype::array({1, 2, 3})}});
+    const jtype &cf = f;
+    const jtype &x = cf["x"];
+    {
+        jtype g = f;
+        f["z"] = 1;
+        g["x"].push_back(99);
+        REQUIRE(g["x"].size() == 4);
+    }
+    REQUIRE(x.size() == 3);
+    REQUIRE(&x == &cf["x"]);
+    
+    // Const references obtained after a copy must keep referring to their owner.
+    jtype h = jtype::object({{"a", 1}});
+    const jtype &ch = h;
+    jtype i = h;
+    const jtype &ha = ch["a"];
+    h["b"] = 2;
+    i["a"] = 9;
+    REQUIRE(ha == 1);
+    REQUIRE(&ha == &ch["a"]);
+    
+    // and must outlive the copies.
+    jtype p = jtype::array({jtype::array({1}), 2});
+    const jtype &cp = p;
+    const jtype *first;
+    {
+        jtype q = p;
+        first = &cp[0];
+        p[1] = 3;
+    }
+    REQUIRE(first->size() == 1);
+    REQUIRE(first == &cp[0]);
+}
+
+#if defined(JTYPES_COPY_ON_WRITE)
+TEST_CASE("jtypes should support versioned updates")
+{
+    using jtypes::jtype;
+    
+    const jtype v0 = jtype::object({{"items", jtype::array({1, 2})}, {"title", "draft"}});
+    const jtype v1 = v0.with("title", "final");
+    const jtype v2 = v1.with("items", v1["items"].push(3));
+    const jtype v3 = v2.with("items", v2["items"].with(0, 10));
+    
+    REQUIRE(v0["title"] == "draft");
+    REQUIRE(v1["title"] == "final");
+    REQUIRE(v1["items"].size() == 2);
+    REQUIRE(v2["items"] == jtype::array({1, 2, 3}));
+    REQUIRE(v3["items"] == jtype::array({10, 2, 3}));
+    REQUIRE(v2["items"][0] == 1);
+    REQUIRE(v0.with("extra", true).size() == 3);
+    REQUIRE(jtype(jtype::array()).with(2, true).size() == 3);
+    
+    REQUIRE_THROWS_AS(v0.with(1, true), jtypes::type_error);
+    REQUIRE_THROWS_AS(v0.push(1), jtypes::type_error);
+}
+#endif
+
+TEST_CASE("jtypes should support interned property names")
+{
+    using jtypes::jtype;
+    using jtypes::atom;
+    using jtypes::atom_table;
+    
+    atom a = "id";
+    atom b = std::string("id");
+    REQUIRE(&a.str() == &b.str());
+    REQUIRE(a == b);
+    REQUIRE(a != atom("ts"));
+    REQUIRE(atom("a") < atom("b"));
+    
+    jtype x = jtype::object({{"id", 1}, {"ts", 2}});
+    REQUIRE(x[a] == 1);
+    x[atom("value")] = 3;
+    REQUIRE(x["value"] == 3);
+    
+    const jtype &xx = x;
+    REQUIRE(xx[a] == 1);
+    REQUIRE(xx[atom("missing")].is_undefined());
+    REQUIRE(xx.size() == 3);
+    
+    REQUIRE_THROWS_AS(jtype(jtype::array())[a], jtypes::type_error);
+    
+    // Scoped tables
+    atom_table doc_keys;
+    {
+        atom_table::scope scope(doc_keys);
+        atom c = "id";
+        REQUIRE(&c.str() != &a.str());
+        REQUIRE(c == a);
+        REQUIRE(x[c] == 1);
+        REQUIRE(doc_keys.size() == 1);
+    }
+    REQUIRE(&atom("id").str() == &a.str());
+}
+
+struct counted_key {
+    static int constructed;
+    std::string s;
+    counted_key(std::string v) : s(std::move(v)) { ++constructed; }
+    counted_key(const counted_key &o) : s(o.s) { ++constructed; }
+    counted_key(counted_key &&o) : s(std::move(o.s)) { ++constructed; }
+    bool operator==(const counted_key &o) const { return s == o.s; }
+};
+int counted_key::constructed = 0;
+
+struct counted_key_hash {
+    std::size_t operator()(const counted_key &k) const { return std::hash<std::string>()(k.s); }
+};
+
+TEST_CASE("jtypes hash map should behave like an associative container")
+{
+    using jtypes::jtype;
+    using map = jtypes::details::flat_map<std::string, int>;
+    
+    map m;
+    REQUIRE(m.empty());
+    REQUIRE(m.find("a") == m.end());
+    
+    // Small maps are scanned linearly until they grow beyond small_size
+    for (int i = 0; i < int(map::small_size); ++i) {
+        m.emplace(std::to_string(i), i);
+    }
+    REQUIRE(m.erase("3") == 1);
+    REQUIRE(m.erase("3") == 0);
+    REQUIRE(m.size() == map::small_size - 1);
+    REQUIRE(m.at("7") == 7);
+    REQUIRE(m.find("3") == m.end());
+    m.clear();
+    
+    for (int i = 0; i < 1000; ++i) {
+        m.emplace(std::to_string(i), i);
+    }
+    REQUIRE(m.size() == 1000);
+    REQUIRE_FALSE(m.emplace("10", 0).second);
+    REQUIRE(m.at("10") == 10);
+    REQUIRE_THROWS_AS(m.at("x"), std::out_of_range);
+    
+    // Insertion order is kept
+    REQUIRE(m.begin()->first == "0");
+    REQUIRE((m.end() - 1)->first == "999");
+    
+    std::size_t erased = 0, found = 0;
+    for (int i = 0; i < 1000; i += 2) {
+        erased += m.erase(std::to_string(i));
+    }
+    for (int i = 0; i < 1000; ++i) {
+        found += m.count(std::to_string(i)) * (i % 2);
+    }
+    REQUIRE(erased == 500);
+    REQUIRE(found == 500);
+    REQUIRE(m.erase("0") == 0);
+    REQUIRE(m.size() == 500);
+    REQUIRE(m.begin()->first == "1");
+    
+    // Entries behind an erased one stay reachable at their new positions
+    bool intact = true;
+    for (int i = 1; i < 1000; i += 2) {
+        intact = intact && m.at(std::to_string(i)) == i && m.begin()[i / 2].second == i;
+    }
+    REQUIRE(intact);
+    
+    // Existing keys are found without constructing a key
+    using counted_map = jtypes::details::flat_map<counted_key, int, counted_key_hash>;
+    counted_map c;
+    for (int i = 0; i < 20; ++i) c.emplace(std::to_string(i), i);
+    counted_key::constructed = 0;
+    REQUIRE_FALSE(c.emplace(counted_key("5"), 0).second);
+    REQUIRE(counted_key::constructed == 1);
+    REQUIRE(c[counted_key("5")] == 5);
+    REQUIRE(counted_key::constructed == 2);
+    
+    map a = {{"x", 1}, {"y", 2}};
+    map b = {{"y", 2}, {"x", 1}};
+    REQUIRE(a == b);
+    b["x"] = 3;
+    REQUIRE(a != b);
+    
+#if defined(JTYPES_HASH_OBJECTS)
+    jtype o = jtype::object();
+    o["z"] = 1;
+    o["a"] = 2;
+    o["m"] = 3;
+    REQUIRE(o.keys() == jtype::array({"z", "a", "m"}));
+#endif
+}
+
+TEST_CASE("jtypes should support cached property access")
+{
+    using jtypes::jtype;
+    
+    jtype records = jtype::array();
+    for (int i = 0; i < 4; ++i) {
+        records.push_back(jtype::object({{"id", i}, {"value", i * 2}}));
+    }
+    records.push_back(jtype::object({{"value", 8}, {"other", 1}}));
+    records.push_back(jtype::object({{"other", 1}}));
+    
+    const jtype::property_accessor value("value");
+    REQUIRE(value.key() == "value");
+    
+    const jtype &crecords = records;
+    int sum = 0;
+    for (auto && r : crecords) {
+        sum += (value(r) | 0).as<int>();
+    }
+    REQUIRE(sum == 20);
+    REQUIRE(value(crecords[5]).is_undefined());
+    
+    value(records[5]) = 10;
+    REQUIRE(records[5]["value"] == 10);
+    REQUIRE(records[5].size() == 2);
+    
+    REQUIRE_THROWS_AS(value(jtype::array()), jtypes::type_error);
+}
+
+TEST_CASE("jtypes should support arena allocation")
+{
+    using jtypes::jtype;
+    using jtypes::arena;
+    
+    REQUIRE(arena::current() == nullptr);
+    
+    jtype copy;
+    {
+        arena a(1024);
+        jtype doc;
+        {
+            arena::scope scope(a);
+            REQUIRE(arena::current() == &a);
+            
+            doc = jtype::object({{"list", jtype::array({1, 2, 3})}});
+            for (int i = 0; i < 100; ++i) {
+                doc["list"].push_back(i);
+                doc[std::to_string(i)] = i;
+            }
+        }
+        REQUIRE(arena::current() == nullptr);
+#if defined(JTYPES_ARENA_ALLOCATION)
+        REQUIRE(a.size() > 0);
+#endif
+        
+        // Copies made outside of the scope do not depend on the arena.
+        const jtype &cdoc = doc;
+        copy = cdoc;
+    }
+    REQUIRE(copy.size() == 101);
+    REQUIRE(copy["list"].size() == 103);
+    REQUIRE(copy["99"] == 99);
+}
+
+TEST_CASE("jtypes containers should be configurable")
+{
+    using jtypes::jtype;
+    
+    static_assert(std::is_same<jtype::array_t, jtypes::details::traits::array_type>::value, "array_t follows traits");
+    static_assert(std::is_same<jtype::object_t, jtypes::details::traits::object_type>::value, "object_t follows traits");
+#if defined(JTYPES_TEST_TRAITS)
+    static_assert(std::is_same<jtype::object_t, std::map<std::string, jtype, key_less> >::value, "custom traits");
+#endif
+    
+    jtype o = jtype::object({{"a", 1}, {"b", jtype::array({1, 2})}});
+    o["c"] = "x";
+    o.merge_from(jtype::object({{"b", jtype::array({3})}}));
+    REQUIRE(o.size() == 3);
+    REQUIRE(o["b"] == jtype::array({3}));
+    REQUIRE(jtypes::from_json(jtypes::to_json(o)) == o);
+}
+
+#if defined(JTYPES_SPARSE_ARRAYS)
+struct stored_size_visitor {
+    std::size_t operator()(const jtypes::jtype::array_t &v) const { return v.is_sparse() ? v.stored_size() : 0; }
+    
+    template<class T>
+    std::size_t operator()(const T &) const { return 0; }
+};
+#endif
+
+TEST_CASE("jtypes should support sparse arrays")
+{
+    using jtypes::jtype;
+    
+    jtype x = jtype::array({1, 2});
+    x[1000000] = 3;
+    REQUIRE(x.size() == 1000001);
+    REQUIRE(x[0] == 1);
+    REQUIRE(x[1000000] == 3);
+    
+    const jtype &cx = x;
+    REQUIRE(cx[500000].is_undefined());
+    REQUIRE(jtypes::to_json(x) == "[1,2,3]");
+    
+    x.push_back(4);
+    REQUIRE(x.size() == 1000002);
+    REQUIRE(x[1000001] == 4);
+    
+    jtype y = x;
+    REQUIRE(y == x);
+    y[10] = 5;
+    REQUIRE(y != x);
+    
+#if defined(JTYPES_SPARSE_ARRAYS)
+    REQUIRE(x.visit(stored_size_visitor()) == 4);
+#endif
+    
+    // Non-const iteration converts to dense storage instead of storing holes one by one.
+    int defined = 0;
+    for (auto && e : x) {
+        defined += e.is_undefined() ? 0 : 1;
+    }
+    REQUIRE(defined == 4);
+    REQUIRE(x.size() == 1000002);
+#if defined(JTYPES_SPARSE_ARRAYS)
+    REQUIRE(x.visit(stored_size_visitor()) == 0);
+#endif
+    
+    jtypes::details::sparse_vector<int> v{1, 2, 3};
+    v.resize(5);
+    REQUIRE(!v.is_sparse());
+    v.resize(5000);
+    REQUIRE(v.is_sparse());
+    REQUIRE(v.stored_size() == 5);
+    
+    int insert[] = {7, 8};
+    v.insert(v.cbegin() + 1, std::begin(insert), std::end(insert));
+    REQUIRE(v.size() == 5002);
+    REQUIRE(v[1] == 7);
+    REQUIRE(v[3] == 2);
+    REQUIRE(v[4] == 3);
+    REQUIRE(v.stored_size() == 7);
+    
+    v.erase(v.cbegin() + 1);
+    REQUIRE(v.size() == 5001);
+    REQUIRE(v[1] == 8);
+    REQUIRE(v[3] == 3);
+    v.erase(v.cbegin() + 10, v.cbegin() + 20);
+    REQUIRE(v.size() == 4991);
+    v.pop_back();
+    REQUIRE(v.size() == 4990);
+    REQUIRE(v.stored_size() == 6);
+    v.insert(v.cbegin() + 1, std::begin(insert), std::begin(insert) + 1);
+    REQUIRE(v.is_sparse());
+    
+    v.begin();
+    REQUIRE(!v.is_sparse());
+    REQUIRE(v.stored_size() == 4991);
+    REQUIRE(v[2] == 8);
+    
+    v.resize(3);
+    REQUIRE(v.stored_size() == 3);
+    REQUIRE((v == jtypes::details::sparse_vector<int>{1, 7, 8}));
+    v.clear();
+    REQUIRE(!v.is_sparse());
+}
+
+TEST_CASE("jtypes should support property access by string")
+{
+    using jtypes::jtype;
+    
+    jtype x = jtype::object({{"a", 1}});
+    const std::string key = "a_property_name_beyond_sso";
+    
+    x[key] = 2;
+    x[std::string("b")] = 3;
+    x["c"] = 1;
+    REQUIRE(key == "a_property_name_beyond_sso");
+    
+    const jtype &cx = x;
+    REQUIRE(cx["a"] == 1);
+    REQUIRE(cx[key] == 2);
+    REQUIRE(cx[std::string("b")] == 3);
+    REQUIRE(cx["c"] == 1);
+    REQUIRE(cx["missing"].is_undefined());
+    REQUIRE(x.size() == 4);
+    REQUIRE(&x["a"] != &x["c"]);
+    
+    jtype y = jtype::array({1, 2});
+    REQUIRE(y[0] == 1);
+    REQUIRE_THROWS_AS(y["a"], jtypes::type_error);
+    REQUIRE_THROWS_AS(static_cast<const jtype&>(y)[key], jtypes::type_error);
+    REQUIRE_THROWS_AS(jtype(1)["a"], jtypes::type_error);
+}
+
+TEST_CASE("jtypes should support non-throwing accessors")
+{
+    using jtypes::jtype;
+    
+    jtype x = jtype::object({
+        {"n", 2.5},
+        {"s", "12"},
+        {"t", "text"},
+        {"a", jtype::array({1, 2})},
+        {"o", jtype::object({{"k", true}})}
+    });
+    
+    // find
+    REQUIRE(x.find("n") == &x["n"]);
+    REQUIRE(x.find("missing") == nullptr);
+    REQUIRE(x.find(std::string("a"))->find(1)->as<int>() == 2);
+    REQUIRE(x["a"].find(2) == nullptr);
+    REQUIRE(x["a"].find("k") == nullptr);
+    REQUIRE(x.find(0) == nullptr);
+    REQUIRE(jtype(1).find("k") == nullptr);
+    REQUIRE(x.size() == 5);
+    
+    const jtype &cx = x;
+    REQUIRE(cx.find(jtype("o"))->find("k")->as<bool>());
+    REQUIRE(cx.find("missing") == nullptr);
+    
+    // get_if
+    REQUIRE(cx["n"].get_if<double>() != nullptr);
+    REQUIRE(*cx["n"].get_if<double>() == 2.5);
+    REQUIRE(cx["n"].get_if<std::int64_t>() == nullptr);
+    REQUIRE(*cx["s"].get_if<std::string>() == "12");
+    REQUIRE(cx["a"].get_if<jtype::array_t>()->size() == 2);
+    REQUIRE(cx["o"].get_if<jtype::object_t>()->size() == 1);
+    REQUIRE(cx["o"].get_if<jtype::array_t>() == nullptr);
+    
+    x["a"].get_if<jtype::array_t>()->push_back(3);
+    REQUIRE(x["a"].size() == 3);
+    
+    // try_as
+    REQUIRE(cx["n"].try_as<int>().value() == 2);
+    REQUIRE(*cx["s"].try_as<std::uint64_t>() == 12);
+    REQUIRE(cx["s"].try_as<double>().value_or(0) == 12.0);
+    REQUIRE(!cx["t"].try_as<int>());
+    REQUIRE(!cx["o"].try_as<double>().has_value());
+    REQUIRE(!cx["missing"].try_as<std::int64_t>());
+    REQUIRE(!jtype(nullptr).try_as<int>());
+    REQUIRE(!jtype("99999999999999999999999").try_as<std::int64_t>());
+    REQUIRE(cx["t"].try_as<int>().value_or(-1) == -1);
+    REQUIRE_THROWS_AS(cx["t"].try_as<int>().value(), jtypes::type_error);
+    REQUIRE(*cx["a"].try_as<std::string>() == "1,2,3");
+    REQUIRE(*cx["o"].try_as<bool>());
+}
+
 TEST_CASE("jtypes should support default values")
 {
     using jtypes::jtype;
@@ -713,6 +1421,15 @@ TEST_CASE("jtypes should support less-than comparison")
     std::less<jtype> less;
     REQUIRE(less(jtype(2u), jtype(3.5)));
     REQUIRE(!less(jtype(3.5), jtype(2u)));
+    
+    // Homogeneous arrays
+    REQUIRE(jtype(jtype::array({1, 2, 3})) < jtype::array({1, 2, 4}));
+    REQUIRE(jtype(jtype::array({1u, 2u})) < jtype::array({1u, 3u}));
+    REQUIRE(jtype(jtype::array({0.5, 1.5})) < jtype::array({1.5}));
+    REQUIRE(jtype(jtype::array({false, true})) < jtype::array({true}));
+    REQUIRE(jtype(jtype::array({1, 2, 3})) == jtype::array({1, 2, 3}));
+    REQUIRE(jtype(jtype::array({1, 2, 3})) == jtype::array({1u, 2.0, 3}));
+    REQUIRE(jtype(jtype::array({true, false})) != jtype::array({true, true}));
 }
 
 TEST_CASE("jtypes should support JSON")
@@ -744,6 +1461,11 @@ TEST_CASE("jtypes should support JSON")
     oss << y;
     REQUIRE(s == oss.str());
     
+    // Indented output is laid out like json::dump()
+    REQUIRE(jtypes::to_json(x, 2) == jtypes::details::to_json(x).dump(2));
+    REQUIRE(jtypes::to_json(x, 0) == jtypes::details::to_json(x).dump(0));
+    REQUIRE(jtypes::to_json(jtype::object({{"a", jtype::array()}}), 4) == "{\n    \"a\": []\n}");
+    
     // Invalid JSON
     REQUIRE_THROWS_AS(jtypes::from_json("dasda"), jtypes::syntax_error);
     
@@ -767,6 +1489,63 @@ TEST_CASE("jtypes should support JSON")
 
 }
 
+TEST_CASE("jtypes should support parsing from buffers")
+{
+    using jtypes::jtype;
+    
+    const std::string doc = R"( {"a": [0, -0, 5, -5, 18446744073709551615, 18446744073709551616, -9223372036854775808, 1.5e2, true, false, null],
+        "s": "plain", "e": "q\"b\\s\/\n\t\u00e9\ud83d\ude00", "o": {"k": {}, "l": []}, "a": "last"} )";
+    
+    jtype x = jtypes::from_json(std::string(doc));
+    REQUIRE(x == jtypes::from_json(static_cast<const std::string&>(doc)));
+    REQUIRE(x["a"] == "last");
+    REQUIRE(x["e"] == "q\"b\\s/\n\t\xc3\xa9\xf0\x9f\x98\x80");
+    
+    jtype n = jtypes::from_json("[0, -0, 5, -5, 18446744073709551615, 18446744073709551616, -9223372036854775808, 1.5e2]");
+    REQUIRE(n[0].is_unsigned_number());
+    REQUIRE(n[1].is_signed_number());
+    REQUIRE(n[3] == -5);
+    REQUIRE(n[4] == std::numeric_limits<std::uint64_t>::max());
+    REQUIRE(n[5].is_real_number());
+    REQUIRE(n[6] == std::numeric_limits<std::int64_t>::min());
+    REQUIRE(n[7] == 150.0);
+    
+    // Buffers need not be null terminated.
+    const char buffer[] = {'[', '1', ',', '2', ']', '3'};
+    REQUIRE(jtypes::from_json(buffer, 5) == jtype::array({1, 2}));
+    REQUIRE_THROWS_AS(jtypes::from_json(buffer, 6), jtypes::syntax_error);
+    
+    std::string moved = doc;
+    REQUIRE(jtypes::from_json(std::move(moved)) == x);
+    REQUIRE(moved.empty());
+    
+    const char *invalid[] = {"", "01", "1.", "[1,]", "{\"a\" 1}", "\"a\tb\"", "\"\\x\"", "\"\\ud800\"", "nul", "[1] x", "\"open", "\xEF\xBB"};
+    for (auto && i : invalid) {
+        const std::string copied = i;
+        REQUIRE_THROWS_AS(jtypes::from_json(std::string(i)), jtypes::syntax_error);
+        REQUIRE_THROWS_AS(jtypes::from_json(copied), jtypes::syntax_error);
+    }
+    
+    // Numbers do not depend on the C locale.
+    const char *comma_locales[] = {"de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "German"};
+    for (auto && l : comma_locales) {
+        const std::string previous = std::setlocale(LC_NUMERIC, nullptr);
+        if (std::setlocale(LC_NUMERIC, l)) {
+            const jtype parsed = jtypes::from_json(std::string("[1.5, 2e-1]"));
+            std::setlocale(LC_NUMERIC, previous.c_str());
+            REQUIRE(parsed == jtype::array({1.5, 0.2}));
+            break;
+        }
+    }
+    
+    // Copied and moved-in buffers accept the same text.
+    const char *valid[] = {"1", " [1, {\"a\": null}] ", "\xEF\xBB\xBF{\"a\": 1}", "\xEF\xBB\xBF \"s\"", "{\"a\": 1, \"a\": 2}"};
+    for (auto && v : valid) {
+        const std::string copied = v;
+        REQUIRE(jtypes::from_json(std::string(v)) == jtypes::from_json(copied));
+    }
+}
+
 #include <iterator>
 
 using namespace jtypes;
@@ -860,9 +1639,228 @@ TEST_CASE("jtypes should support iterators")
     {
         jtype x = 1;
         REQUIRE(x.begin() == x.end());
+        REQUIRE_THROWS_AS(x.elements(), jtypes::type_error);
+        REQUIRE_THROWS_AS(x.properties(), jtypes::type_error);
+    }
+    
+    {
+        // Bidirectional iteration, mixed constness
+        jtype x = jtype::array({1, 2, 3});
+        const jtype &cx = x;
+        
+        auto i = x.end();
+        --i;
+        REQUIRE(*i == 3);
+        REQUIRE(i.key() == 2);
+        i--;
+        REQUIRE(*i == 2);
+        REQUIRE(i != cx.begin());
+        REQUIRE(--i == cx.begin());
+        
+        jtype o = jtype::object({{"a", 1}, {"b", 2}});
+        auto j = o.end();
+        --j;
+        REQUIRE(j.key() == "b");
+        REQUIRE(std::distance(o.begin(), o.end()) == 2);
+    }
+    
+    {
+        // Random access through elements()
+        jtype x = jtype::array({5, 3, 9, 1, 7});
+        auto e = x.elements();
+        std::sort(e.begin(), e.end());
+        REQUIRE(x == jtype::array({1, 3, 5, 7, 9}));
+        
+        const jtype &cx = x;
+        auto ce = cx.elements();
+        REQUIRE(ce.end() - ce.begin() == 5);
+        REQUIRE(*std::lower_bound(ce.begin(), ce.end(), jtype(6)) == 7);
+        REQUIRE(ce.begin()[2] == 5);
+        
+        jtype o = jtype::object({{"a", 1}, {"b", 2}});
+        int sum = 0;
+        for (auto && p : static_cast<const jtype&>(o).properties()) {
+            sum += p.second.as<int>();
+        }
+        REQUIRE(sum == 3);
+        for (auto && p : o.properties()) {
+            p.second = 0;
+        }
+        REQUIRE(o["b"] == 0);
     }
 }
 
+struct describe_visitor {
+    std::string operator()(const jtypes::jtype::undefined_t &) const { return "undefined"; }
+    std::string operator()(const std::int64_t &v) const { return "signed"; }
+    std::string operator()(const double &v) const { return "real"; }
+    std::string operator()(const std::string &v) const { return "string:" + v; }
+    std::string operator()(const jtypes::jtype::array_t &v) const { return "array:" + std::to_string(v.size()); }
+    
+    template<class T>
+    std::string operator()(const T &) const { return "other"; }
+};
+
+struct increment_visitor {
+    void operator()(std::int64_t &v) const { ++v; }
+    
+    template<class T>
+    void operator()(T &) const {}
+};
+
+TEST_CASE("jtypes should support lazy views")
+{
+    using jtypes::jtype;
+    
+    jtype o = jtype::object({{"a", 1}, {"b", 2}, {"c", 3}});
+    const jtype &co = o;
+    
+    jtype names = jtype::array();
+    for (auto && k : co.keys_view()) {
+        REQUIRE(!k.is_index());
+        names.push_back(jtype(k.name()));
+    }
+    REQUIRE(names == jtype(co.keys()));
+    
+    int sum = 0;
+    for (auto && v : co.values_view()) {
+        sum += v.as<int>();
+    }
+    REQUIRE(sum == 6);
+    REQUIRE(jtype(co.values()) == jtype::array({1, 2, 3}));
+    
+    for (auto && kv : o.items()) {
+        kv.value = kv.key.name() + "!";
+    }
+    REQUIRE(o["b"] == "b!");
+    
+    for (auto iter = co.begin(); iter != co.end(); ++iter) {
+        REQUIRE(jtype(iter.key_ref()) == iter.key());
+    }
+    
+    jtype a = jtype::array({"x", "y"});
+    std::uint64_t next = 0;
+    for (auto && kv : static_cast<const jtype&>(a).items()) {
+        REQUIRE(kv.key.is_index());
+        REQUIRE(kv.key.index() == next++);
+        REQUIRE_THROWS_AS(kv.key.name(), jtypes::type_error);
+        REQUIRE(kv.value == a[kv.key.index()]);
+    }
+    REQUIRE(next == 2);
+    REQUIRE(jtype(*a.keys_view().begin()) == 0);
+    
+    for (auto && v : a.values_view()) {
+        v = 0;
+    }
+    REQUIRE(a == jtype::array({0, 0}));
+    
+    REQUIRE(jtype(1).keys_view().empty());
+    REQUIRE(jtype().items().empty());
+}
+
+TEST_CASE("jtypes should support visitation")
+{
+    using jtypes::jtype;
+    
+    describe_visitor d;
+    REQUIRE(jtype().visit(d) == "undefined");
+    REQUIRE(jtype(1).visit(d) == "signed");
+    REQUIRE(jtype(1u).visit(d) == "other");
+    REQUIRE(jtype(1.5).visit(d) == "real");
+    REQUIRE(jtype("x").visit(d) == "string:x");
+    REQUIRE(jtype(jtype::array({1, 2})).visit(d) == "array:2");
+    REQUIRE(jtype(jtype::object()).visit(d) == "other");
+    
+    jtype x = 1;
+    x.visit(increment_visitor());
+    REQUIRE(x == 2);
+    
+    x = "a";
+    x.visit(increment_visitor());
+    REQUIRE(x == "a");
+}
+
+TEST_CASE("jtypes should support typed arrays")
+{
+    using jtypes::jtype;
+    
+    jtypes::float64_array samples = {0.5, 1.5, 2.5};
+    REQUIRE(samples.size() == 3);
+    REQUIRE(samples.byte_length() == 24);
+    REQUIRE(samples.data()[1] == 1.5);
+    
+    double sum = 0;
+    for (auto v : samples) {
+        sum += v;
+    }
+    REQUIRE(sum == 4.5);
+    
+    // Views share their buffer
+    jtypes::array_buffer buffer(16);
+    jtypes::int32_array ints(buffer);
+    jtypes::uint8_array bytes(buffer, 4, 4);
+    REQUIRE(ints.size() == 4);
+    ints[1] = 0x01010101;
+    REQUIRE(bytes[0] == 1);
+    REQUIRE(bytes[3] == 1);
+    REQUIRE(ints.subarray(1, 3).size() == 2);
+    REQUIRE(ints.subarray(1, 3)[0] == 0x01010101);
+    REQUIRE(buffer.slice(4, 8) != buffer);
+    
+    REQUIRE_THROWS_AS(jtypes::int32_array(buffer, 2), jtypes::range_error);
+    REQUIRE_THROWS_AS(jtypes::int32_array(buffer, 0, 5), jtypes::range_error);
+    
+    // Round trip through jtype and JSON
+    jtype j = jtype::array(samples.begin(), samples.end());
+    REQUIRE(jtypes::to_json(j) == "[0.5,1.5,2.5]");
+    REQUIRE(jtypes::float64_array(jtypes::from_json("[0.5,1.5,2.5]")) == samples);
+    REQUIRE(jtypes::int32_array(jtype::array({1, "2", 3.0}))[1] == 2);
+    REQUIRE_THROWS_AS(jtypes::int32_array(jtype("x")), jtypes::type_error);
+}
+
+TEST_CASE("jtypes should support ropes")
+{
+    using jtypes::jtype;
+    using jtypes::rope;
+    
+    rope r;
+    std::string s;
+    for (int i = 0; i < 2000; ++i) {
+        const std::string part = "line " + std::to_string(i) + "\n";
+        r += part;
+        s += part;
+    }
+    
+    REQUIRE(r.size() == s.size());
+    REQUIRE(r.str() == s);
+    REQUIRE(r[12345] == s[12345]);
+    REQUIRE(r[s.size()] == '\0');
+    REQUIRE(rope()[0] == '\0');
+    REQUIRE_THROWS_AS(r.at(s.size()), jtypes::range_error);
+    
+    rope sub = r.substr(1000, 20000);
+    REQUIRE(sub.str() == s.substr(1000, 20000));
+    REQUIRE(r.substr(s.size() - 5).str() == s.substr(s.size() - 5));
+    REQUIRE(r.substr(3, 0).empty());
+    REQUIRE_THROWS_AS(r.substr(s.size() + 1), jtypes::range_error);
+    
+    rope joined = sub + "tail" + r.substr(0, 1000);
+    REQUIRE(joined.str() == s.substr(1000, 20000) + "tail" + s.substr(0, 1000));
+    REQUIRE(joined == rope(joined.str()));
+    REQUIRE(joined != r);
+    REQUIRE(rope("abc") < rope("abd"));
+    REQUIRE(rope("ab") < rope("abc"));
+    
+    jtype x = jtype(joined);
+    REQUIRE(x.is_string());
+    REQUIRE(x.as<std::string>() == joined.str());
+    REQUIRE(rope(jtype(42)).str() == "42");
+    
+    std::ostringstream os;
+    jtypes::write_json(os, rope("a\"b\\c\n\x01") + rope("\tok"));
+    REQUIRE(os.str() == jtypes::to_json(jtype("a\"b\\c\n\x01\tok")));
+}
+
 TEST_CASE("jtypes should support merging")
 {
     using jtypes::jtype;
@@ -920,3 +1918,22 @@ TEST_CASE("jtypes undefined behaviour should mimic ECMAScript 5 behaviour")
 
 
 
+
+#if defined(JTYPES_COMPACT_STORAGE)
+TEST_CASE("jtypes compact storage should fit into 16 bytes")
+{
+    using jtypes::jtype;
+    
+    REQUIRE(sizeof(jtype) <= 16);
+    
+    jtype x = jtype::array({1, 2u, 3.5, "hello", jtype::object({{"a", nullptr}})});
+    jtype y = x;
+    y[3] = "world";
+    
+    REQUIRE(x[3] == "hello");
+    REQUIRE(y[3] == "world");
+    REQUIRE(x[1].is_unsigned_number());
+    REQUIRE(x[2].is_real_number());
+    REQUIRE(x[4]["a"].is_null());
+}
+#endif
@@ -0,0 +1,36 @@
+/**
+This file is part of jtypes.
+
+Copyright(C) 2016 Christoph Heindl
+All rights reserved.
+
+This software may be modified and distributed under the terms
+of MIT license. See the LICENSE file for details.
+*/
+
+#ifndef JTYPES_TEST_TRAITS_H
+#define JTYPES_TEST_TRAITS_H
+
+// Custom containers used by the jtypes-tests-traits target, must be seen by all compile units.
+
+#if defined(JTYPES_TEST_TRAITS)
+
+#include <vector>
+#include <string>
+#include <map>
+
+struct key_less {
+    bool operator()(const std::string &lhs, const std::string &rhs) const { return lhs.compare(rhs) < 0; }
+};
+
+template<typename Value, typename Key>
+struct custom_traits {
+    using array_type = std::vector<Value>;
+    using object_type = std::map<Key, Value, key_less>;
+};
+
+#define JTYPES_TRAITS custom_traits
+
+#endif
+
+#endif